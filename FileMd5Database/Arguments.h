@@ -129,7 +129,7 @@ namespace ArgumentsParse
 	private:
 		std::string name;
 		std::string desc;
-		std::any val = std::nullopt;
+		std::any val = ValueTypeOpt{};
 		ConvertFuncType convert;
 	};
 
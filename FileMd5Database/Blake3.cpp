@@ -0,0 +1,252 @@
+#include "Cryptography.h"
+
+#include <algorithm>
+#include <cstring>
+#include <execution>
+#include <vector>
+
+#include "Blake3MultiBuffer.h"
+#include "Cpu.h"
+
+namespace Cryptography
+{
+	namespace
+	{
+		void Blake3HashMany(const MultiBuffer::Blake3Job& job)
+		{
+			static const auto avx512 = Cpu::Avx512();
+			static const auto avx2 = Cpu::Avx2();
+			static const auto sse2 = Cpu::Sse2();
+			if (avx512 && MultiBuffer::Blake3Avx512(job)) return;
+			if (avx2 && MultiBuffer::Blake3Avx2(job)) return;
+			if (sse2 && MultiBuffer::Blake3Sse2(job)) return;
+			MultiBuffer::Blake3HashMany<MultiBuffer::Blake3Scalar>(job);
+		}
+
+		std::uint64_t FloorPowerOf2(const std::uint64_t x)
+		{
+			std::uint64_t p = 1;
+			while (p <= x / 2) p *= 2;
+			return p;
+		}
+
+		// chaining values of the two children of the root of a whole, aligned subtree of at least two chunks
+		void Blake3Subtree(const std::uint8_t* input, const std::uint64_t chunks, const std::uint64_t counter, std::uint32_t (&out)[2][8])
+		{
+			constexpr std::uint64_t chunkLen = 1024;
+			// a group of chunks is the unit of work per thread, small subtrees stay on the calling thread
+			constexpr std::uint64_t groupChunks = 256;
+
+			std::vector<std::uint8_t> cvs(chunks * 32);
+			std::vector<const std::uint8_t*> inputs(chunks);
+			for (std::uint64_t i = 0; i < chunks; ++i) inputs[i] = input + i * chunkLen;
+			const auto hashChunks = [&](const std::uint64_t begin, const std::uint64_t count)
+			{
+				Blake3HashMany({ inputs.data() + begin, count, chunkLen / 64, MultiBuffer::Blake3Iv, counter + begin, true, 0, MultiBuffer::ChunkStart, MultiBuffer::ChunkEnd, cvs.data() + begin * 32 });
+			};
+			if (chunks >= groupChunks * 2)
+			{
+				std::vector<std::uint64_t> groups(chunks / groupChunks);
+				for (std::size_t i = 0; i < groups.size(); ++i) groups[i] = i * groupChunks;
+				std::for_each(std::execution::par, groups.begin(), groups.end(), [&](const std::uint64_t begin)
+				{
+					hashChunks(begin, groupChunks);
+				});
+			}
+			else
+			{
+				hashChunks(0, chunks);
+			}
+
+			// every parent block is two adjacent chaining values
+			std::vector<std::uint8_t> parents(chunks / 2 * 32);
+			for (auto count = chunks; count > 2; count /= 2)
+			{
+				for (std::uint64_t i = 0; i < count / 2; ++i) inputs[i] = cvs.data() + i * 64;
+				Blake3HashMany({ inputs.data(), count / 2, 1, MultiBuffer::Blake3Iv, 0, false, MultiBuffer::Parent, 0, 0, parents.data() });
+				std::swap(cvs, parents);
+			}
+			for (auto i = 0; i < 2; ++i)
+			{
+				for (auto j = 0; j < 8; ++j) out[i][j] = MultiBuffer::Blake3LoadLe32(cvs.data() + i * 32 + j * 4);
+			}
+		}
+
+		void Blake3Parent(const std::uint32_t* left, const std::uint32_t* right, std::uint8_t (&block)[64])
+		{
+			for (auto i = 0; i < 8; ++i)
+			{
+				MultiBuffer::Blake3StoreLe32(block + i * 4, left[i]);
+				MultiBuffer::Blake3StoreLe32(block + 32 + i * 4, right[i]);
+			}
+		}
+	}
+
+	Blake3::Blake3()
+	{
+		ChunkReset(0);
+	}
+
+	std::size_t Blake3::ChunkBytes() const
+	{
+		return blocksCompressed * BlockLen + blockLen;
+	}
+
+	std::uint8_t Blake3::ChunkStart() const
+	{
+		return blocksCompressed == 0 ? MultiBuffer::ChunkStart : 0;
+	}
+
+	void Blake3::ChunkReset(const std::uint64_t counter)
+	{
+		memcpy(chunkCv, MultiBuffer::Blake3Iv, sizeof chunkCv);
+		chunkCounter = counter;
+		memset(block, 0, sizeof block);
+		blockLen = 0;
+		blocksCompressed = 0;
+	}
+
+	void Blake3::ChunkUpdate(const std::uint8_t* buf, std::size_t len)
+	{
+		while (len != 0)
+		{
+			// the last block of a chunk stays buffered, it is compressed with ChunkEnd
+			if (blockLen == BlockLen)
+			{
+				MultiBuffer::Blake3Compress(chunkCv, block, BlockLen, chunkCounter, ChunkStart(), chunkCv);
+				++blocksCompressed;
+				memset(block, 0, sizeof block);
+				blockLen = 0;
+			}
+			const auto take = std::min(BlockLen - blockLen, len);
+			memcpy(block + blockLen, buf, take);
+			blockLen += static_cast<std::uint8_t>(take);
+			buf += take;
+			len -= take;
+		}
+	}
+
+	Blake3::Output Blake3::ChunkOutput() const
+	{
+		Output output{};
+		memcpy(output.Cv, chunkCv, sizeof output.Cv);
+		memcpy(output.Block, block, sizeof output.Block);
+		output.Length = blockLen;
+		output.Counter = chunkCounter;
+		output.Flags = static_cast<std::uint8_t>(ChunkStart() | MultiBuffer::ChunkEnd);
+		return output;
+	}
+
+	void Blake3::MergeStack(const std::uint64_t totalChunks)
+	{
+		// a complete subtree per set bit of the chunk count
+		std::uint8_t post = 0;
+		for (auto n = totalChunks; n != 0; n &= n - 1) ++post;
+		while (cvStackLen > post)
+		{
+			std::uint8_t parent[BlockLen];
+			Blake3Parent(cvStack[cvStackLen - 2], cvStack[cvStackLen - 1], parent);
+			MultiBuffer::Blake3Compress(MultiBuffer::Blake3Iv, parent, BlockLen, 0, MultiBuffer::Parent, cvStack[cvStackLen - 2]);
+			--cvStackLen;
+		}
+	}
+
+	void Blake3::PushCv(const std::uint32_t* cv, const std::uint64_t counter)
+	{
+		MergeStack(counter);
+		memcpy(cvStack[cvStackLen++], cv, sizeof cvStack[0]);
+	}
+
+	void Blake3::Append(const std::uint8_t* buf, std::uint64_t len)
+	{
+		if (ChunkBytes() != 0)
+		{
+			const auto take = std::min<std::uint64_t>(ChunkLen - ChunkBytes(), len);
+			ChunkUpdate(buf, take);
+			buf += take;
+			len -= take;
+			if (len == 0) return;
+			const auto output = ChunkOutput();
+			std::uint32_t cv[8];
+			MultiBuffer::Blake3Compress(output.Cv, output.Block, output.Length, output.Counter, output.Flags, cv);
+			PushCv(cv, chunkCounter);
+			ChunkReset(chunkCounter + 1);
+		}
+
+		// whole subtrees aligned to the chunk count, the final chunk is kept for the root
+		while (len > ChunkLen)
+		{
+			auto subtreeLen = FloorPowerOf2(len);
+			while (((subtreeLen - 1) & chunkCounter * ChunkLen) != 0) subtreeLen /= 2;
+			const auto subtreeChunks = subtreeLen / ChunkLen;
+			if (subtreeChunks == 1)
+			{
+				ChunkUpdate(buf, ChunkLen);
+				const auto output = ChunkOutput();
+				std::uint32_t cv[8];
+				MultiBuffer::Blake3Compress(output.Cv, output.Block, output.Length, output.Counter, output.Flags, cv);
+				PushCv(cv, chunkCounter);
+			}
+			else
+			{
+				std::uint32_t children[2][8];
+				Blake3Subtree(buf, subtreeChunks, chunkCounter, children);
+				PushCv(children[0], chunkCounter);
+				PushCv(children[1], chunkCounter + subtreeChunks / 2);
+			}
+			ChunkReset(chunkCounter + subtreeChunks);
+			buf += subtreeLen;
+			len -= subtreeLen;
+		}
+
+		if (len != 0)
+		{
+			ChunkUpdate(buf, len);
+			MergeStack(chunkCounter);
+		}
+	}
+
+	void Blake3::Digest(std::uint8_t* out, const std::size_t len) const
+	{
+		Output output{};
+		std::size_t remaining = cvStackLen;
+		if (cvStackLen == 0 || ChunkBytes() != 0)
+		{
+			output = ChunkOutput();
+		}
+		else
+		{
+			// a chunk count that is a power of two ends with the two children of the root on the stack
+			remaining = cvStackLen - 2;
+			memcpy(output.Cv, MultiBuffer::Blake3Iv, sizeof output.Cv);
+			Blake3Parent(cvStack[remaining], cvStack[remaining + 1], output.Block);
+			output.Length = BlockLen;
+			output.Counter = 0;
+			output.Flags = MultiBuffer::Parent;
+		}
+		while (remaining != 0)
+		{
+			--remaining;
+			std::uint32_t cv[8];
+			MultiBuffer::Blake3Compress(output.Cv, output.Block, output.Length, output.Counter, output.Flags, cv);
+			memcpy(output.Cv, MultiBuffer::Blake3Iv, sizeof output.Cv);
+			Blake3Parent(cvStack[remaining], cv, output.Block);
+			output.Length = BlockLen;
+			output.Counter = 0;
+			output.Flags = MultiBuffer::Parent;
+		}
+
+		std::uint32_t words[8];
+		MultiBuffer::Blake3Compress(output.Cv, output.Block, output.Length, 0, static_cast<std::uint8_t>(output.Flags | MultiBuffer::Root), words);
+		std::uint8_t bytes[OutLen];
+		for (auto i = 0; i < 8; ++i) MultiBuffer::Blake3StoreLe32(bytes + i * 4, words[i]);
+		memcpy(out, bytes, std::min(len, OutLen));
+	}
+
+	Blake3::DigestData Blake3::Digest() const
+	{
+		DigestData data{};
+		Digest(data.data(), data.size());
+		return data;
+	}
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace Cryptography::MultiBuffer
+{
+	// hashes count inputs of blocks 64 byte blocks each into 32 byte chaining values, chunks and parents alike
+	struct Blake3Job
+	{
+		const std::uint8_t* const* Inputs;
+		std::size_t Count;
+		std::size_t Blocks;
+		const std::uint32_t* Key;
+		std::uint64_t Counter;
+		bool IncrementCounter;
+		std::uint8_t Flags;
+		std::uint8_t FlagsStart;
+		std::uint8_t FlagsEnd;
+		std::uint8_t* Out;
+	};
+
+	bool Blake3Sse2(const Blake3Job& job);
+
+	bool Blake3Avx2(const Blake3Job& job);
+
+	bool Blake3Avx512(const Blake3Job& job);
+
+	// internal linkage on purpose: every ISA translation unit is built with its own target flags
+	namespace
+	{
+		constexpr std::uint32_t Blake3Iv[8]
+		{
+			0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au, 0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u
+		};
+
+		enum Blake3Flag : std::uint8_t { ChunkStart = 1, ChunkEnd = 2, Parent = 4, Root = 8 };
+
+		// the message words of every round, each row permutes the previous one
+		constexpr auto Blake3Schedule = []()
+		{
+			constexpr std::size_t permutation[16]{ 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 };
+			std::array<std::array<std::size_t, 16>, 7> schedule{};
+			for (std::size_t i = 0; i < 16; ++i) schedule[0][i] = i;
+			for (std::size_t r = 1; r < 7; ++r)
+			{
+				for (std::size_t i = 0; i < 16; ++i) schedule[r][i] = schedule[r - 1][permutation[i]];
+			}
+			return schedule;
+		}();
+
+		template<typename Isa>
+		inline void Blake3G(typename Isa::V* v, const std::size_t a, const std::size_t b, const std::size_t c, const std::size_t d, const typename Isa::V x, const typename Isa::V y)
+		{
+			v[a] = Isa::Add(Isa::Add(v[a], v[b]), x);
+			v[d] = Isa::template Rotr<16>(Isa::Xor(v[d], v[a]));
+			v[c] = Isa::Add(v[c], v[d]);
+			v[b] = Isa::template Rotr<12>(Isa::Xor(v[b], v[c]));
+			v[a] = Isa::Add(Isa::Add(v[a], v[b]), y);
+			v[d] = Isa::template Rotr<8>(Isa::Xor(v[d], v[a]));
+			v[c] = Isa::Add(v[c], v[d]);
+			v[b] = Isa::template Rotr<7>(Isa::Xor(v[b], v[c]));
+		}
+
+		template<typename Isa, std::size_t R>
+		inline void Blake3Round(typename Isa::V* v, const typename Isa::V* m)
+		{
+			constexpr auto& s = Blake3Schedule[R];
+			Blake3G<Isa>(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+			Blake3G<Isa>(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+			Blake3G<Isa>(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+			Blake3G<Isa>(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+			Blake3G<Isa>(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+			Blake3G<Isa>(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+			Blake3G<Isa>(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+			Blake3G<Isa>(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+		}
+
+		template<typename Isa, std::size_t... R>
+		inline void Blake3Rounds(typename Isa::V* v, const typename Isa::V* m, std::index_sequence<R...>)
+		{
+			(Blake3Round<Isa, R>(v, m), ...);
+		}
+
+		inline std::uint32_t Blake3LoadLe32(const std::uint8_t* p)
+		{
+			return static_cast<std::uint32_t>(p[0]) | static_cast<std::uint32_t>(p[1]) << 8 | static_cast<std::uint32_t>(p[2]) << 16 | static_cast<std::uint32_t>(p[3]) << 24;
+		}
+
+		inline void Blake3StoreLe32(std::uint8_t* p, const std::uint32_t x)
+		{
+			for (auto i = 0; i < 4; ++i) p[i] = static_cast<std::uint8_t>(x >> (8 * i));
+		}
+
+		struct Blake3Scalar
+		{
+			using V = std::uint32_t;
+			static constexpr std::size_t Lanes = 1;
+
+			static V Load(const std::uint32_t* p) { return *p; }
+			static void Store(std::uint32_t* p, const V v) { *p = v; }
+			static V Set1(const std::uint32_t x) { return x; }
+			static V Add(const V a, const V b) { return a + b; }
+			static V Xor(const V a, const V b) { return a ^ b; }
+
+			template<int S>
+			static V Rotr(const V a) { return a >> S | a << (32 - S); }
+		};
+
+		// the first 8 words of the compression output, enough for chaining values and outputs up to 32 bytes
+		inline void Blake3Compress(const std::uint32_t* cv, const std::uint8_t* block, const std::uint8_t blockLen, const std::uint64_t counter, const std::uint8_t flags, std::uint32_t* out)
+		{
+			std::uint32_t m[16];
+			for (auto i = 0; i < 16; ++i) m[i] = Blake3LoadLe32(block + i * 4);
+			std::uint32_t v[16]
+			{
+				cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+				Blake3Iv[0], Blake3Iv[1], Blake3Iv[2], Blake3Iv[3],
+				static_cast<std::uint32_t>(counter), static_cast<std::uint32_t>(counter >> 32), blockLen, flags
+			};
+			Blake3Rounds<Blake3Scalar>(v, m, std::make_index_sequence<7>{});
+			for (auto i = 0; i < 8; ++i) out[i] = v[i] ^ v[i + 8];
+		}
+
+		template<typename Isa>
+		void Blake3HashMany(const Blake3Job& job)
+		{
+			using V = typename Isa::V;
+			constexpr auto lanes = Isa::Lanes;
+
+			alignas(64) std::uint32_t words[16][lanes];
+			alignas(64) std::uint32_t counterLow[lanes];
+			alignas(64) std::uint32_t counterHigh[lanes];
+			alignas(64) std::uint32_t cv[8][lanes];
+
+			for (std::size_t base = 0; base < job.Count; base += lanes)
+			{
+				const auto n = std::min(lanes, job.Count - base);
+				for (std::size_t l = 0; l < lanes; ++l)
+				{
+					const auto counter = job.Counter + (job.IncrementCounter ? base + l : 0);
+					counterLow[l] = static_cast<std::uint32_t>(counter);
+					counterHigh[l] = static_cast<std::uint32_t>(counter >> 32);
+				}
+
+				V h[8];
+				for (auto i = 0; i < 8; ++i) h[i] = Isa::Set1(job.Key[i]);
+				for (std::size_t b = 0; b < job.Blocks; ++b)
+				{
+					// idle lanes repeat the last input and are not stored
+					for (std::size_t l = 0; l < lanes; ++l)
+					{
+						const auto* block = job.Inputs[base + std::min(l, n - 1)] + b * 64;
+						for (auto i = 0; i < 16; ++i) words[i][l] = Blake3LoadLe32(block + i * 4);
+					}
+					V m[16];
+					for (auto i = 0; i < 16; ++i) m[i] = Isa::Load(words[i]);
+
+					const auto flags = static_cast<std::uint8_t>(job.Flags | (b == 0 ? job.FlagsStart : 0) | (b + 1 == job.Blocks ? job.FlagsEnd : 0));
+					V v[16]
+					{
+						h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+						Isa::Set1(Blake3Iv[0]), Isa::Set1(Blake3Iv[1]), Isa::Set1(Blake3Iv[2]), Isa::Set1(Blake3Iv[3]),
+						Isa::Load(counterLow), Isa::Load(counterHigh), Isa::Set1(64), Isa::Set1(flags)
+					};
+					Blake3Rounds<Isa>(v, m, std::make_index_sequence<7>{});
+					for (auto i = 0; i < 8; ++i) h[i] = Isa::Xor(v[i], v[i + 8]);
+				}
+
+				for (auto i = 0; i < 8; ++i) Isa::Store(cv[i], h[i]);
+				for (std::size_t l = 0; l < n; ++l)
+				{
+					for (auto i = 0; i < 8; ++i) Blake3StoreLe32(job.Out + (base + l) * 32 + i * 4, cv[i][l]);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#include "Blake3MultiBuffer.h"
+
+#if defined(__AVX2__) || (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)))
+
+#include <immintrin.h>
+
+namespace Cryptography::MultiBuffer
+{
+	namespace
+	{
+		struct Avx2
+		{
+			using V = __m256i;
+			static constexpr std::size_t Lanes = 8;
+
+			static V Load(const std::uint32_t* p) { return _mm256_load_si256(reinterpret_cast<const V*>(p)); }
+			static void Store(std::uint32_t* p, const V v) { _mm256_store_si256(reinterpret_cast<V*>(p), v); }
+			static V Set1(const std::uint32_t x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+			static V Add(const V a, const V b) { return _mm256_add_epi32(a, b); }
+			static V Xor(const V a, const V b) { return _mm256_xor_si256(a, b); }
+
+			template<int S>
+			static V Rotr(const V a) { return _mm256_or_si256(_mm256_srli_epi32(a, S), _mm256_slli_epi32(a, 32 - S)); }
+		};
+	}
+
+	bool Blake3Avx2(const Blake3Job& job)
+	{
+		Blake3HashMany<Avx2>(job);
+		return true;
+	}
+}
+
+#else
+
+namespace Cryptography::MultiBuffer
+{
+	bool Blake3Avx2(const Blake3Job&)
+	{
+		return false;
+	}
+}
+
+#endif
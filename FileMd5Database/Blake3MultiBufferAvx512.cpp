@@ -0,0 +1,44 @@
+#include "Blake3MultiBuffer.h"
+
+#if defined(__AVX512F__) || (defined(_MSC_VER) && defined(_M_X64))
+
+#include <immintrin.h>
+
+namespace Cryptography::MultiBuffer
+{
+	namespace
+	{
+		struct Avx512
+		{
+			using V = __m512i;
+			static constexpr std::size_t Lanes = 16;
+
+			static V Load(const std::uint32_t* p) { return _mm512_load_si512(p); }
+			static void Store(std::uint32_t* p, const V v) { _mm512_store_si512(p, v); }
+			static V Set1(const std::uint32_t x) { return _mm512_set1_epi32(static_cast<int>(x)); }
+			static V Add(const V a, const V b) { return _mm512_add_epi32(a, b); }
+			static V Xor(const V a, const V b) { return _mm512_xor_si512(a, b); }
+
+			template<int S>
+			static V Rotr(const V a) { return _mm512_ror_epi32(a, S); }
+		};
+	}
+
+	bool Blake3Avx512(const Blake3Job& job)
+	{
+		Blake3HashMany<Avx512>(job);
+		return true;
+	}
+}
+
+#else
+
+namespace Cryptography::MultiBuffer
+{
+	bool Blake3Avx512(const Blake3Job&)
+	{
+		return false;
+	}
+}
+
+#endif
@@ -0,0 +1,44 @@
+#include "Blake3MultiBuffer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <immintrin.h>
+
+namespace Cryptography::MultiBuffer
+{
+	namespace
+	{
+		struct Sse2
+		{
+			using V = __m128i;
+			static constexpr std::size_t Lanes = 4;
+
+			static V Load(const std::uint32_t* p) { return _mm_load_si128(reinterpret_cast<const V*>(p)); }
+			static void Store(std::uint32_t* p, const V v) { _mm_store_si128(reinterpret_cast<V*>(p), v); }
+			static V Set1(const std::uint32_t x) { return _mm_set1_epi32(static_cast<int>(x)); }
+			static V Add(const V a, const V b) { return _mm_add_epi32(a, b); }
+			static V Xor(const V a, const V b) { return _mm_xor_si128(a, b); }
+
+			template<int S>
+			static V Rotr(const V a) { return _mm_or_si128(_mm_srli_epi32(a, S), _mm_slli_epi32(a, 32 - S)); }
+		};
+	}
+
+	bool Blake3Sse2(const Blake3Job& job)
+	{
+		Blake3HashMany<Sse2>(job);
+		return true;
+	}
+}
+
+#else
+
+namespace Cryptography::MultiBuffer
+{
+	bool Blake3Sse2(const Blake3Job&)
+	{
+		return false;
+	}
+}
+
+#endif
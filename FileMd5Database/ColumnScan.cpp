@@ -0,0 +1,56 @@
+#include "ColumnScan.h"
+
+#include <algorithm>
+#include <execution>
+#include <limits>
+
+#include "Cpu.h"
+
+namespace ColumnScan
+{
+	template<typename T>
+	static std::uint64_t Dispatch(const T* values, const std::uint64_t count, const std::uint64_t base, const Op op, const T key, std::uint64_t* out)
+	{
+		static const auto avx512 = Cpu::Avx512();
+		static const auto avx2 = Cpu::Avx2();
+		constexpr auto missing = std::numeric_limits<std::uint64_t>::max();
+		if (avx512)
+		{
+			if (const auto n = Kernel::Avx512(values, count, base, op, key, out); n != missing) return n;
+		}
+		if (avx2)
+		{
+			if (const auto n = Kernel::Avx2(values, count, base, op, key, out); n != missing) return n;
+		}
+		return Kernel::Scalar(values, count, base, op, key, out);
+	}
+
+	template<typename T>
+	static void ScanImpl(const T* values, const std::uint64_t count, const Op op, const T key, std::vector<std::uint64_t>& selection)
+	{
+		constexpr std::uint64_t chunkSize = 1 << 20;
+		const auto chunks = (count + chunkSize - 1) / chunkSize;
+		std::vector<std::vector<std::uint64_t>> parts(chunks);
+		std::for_each(std::execution::par, parts.begin(), parts.end(), [&](std::vector<std::uint64_t>& part)
+		{
+			const auto begin = static_cast<std::uint64_t>(&part - parts.data()) * chunkSize;
+			const auto len = std::min(chunkSize, count - begin);
+			part.resize(len);
+			part.resize(Dispatch(values + begin, len, begin, op, key, part.data()));
+		});
+		std::uint64_t total = 0;
+		for (const auto& part : parts) total += part.size();
+		selection.reserve(selection.size() + total);
+		for (const auto& part : parts) selection.insert(selection.end(), part.begin(), part.end());
+	}
+
+	void Scan(const std::uint64_t* values, const std::uint64_t count, const Op op, const std::uint64_t key, std::vector<std::uint64_t>& selection)
+	{
+		ScanImpl(values, count, op, key, selection);
+	}
+
+	void Scan(const std::int64_t* values, const std::uint64_t count, const Op op, const std::int64_t key, std::vector<std::uint64_t>& selection)
+	{
+		ScanImpl(values, count, op, key, selection);
+	}
+}
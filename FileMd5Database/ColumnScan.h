@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace ColumnScan
+{
+	enum class Op { Eq, Lt, Gt };
+
+	// appends the indices of all values matching `value op key` to selection
+	void Scan(const std::uint64_t* values, std::uint64_t count, Op op, std::uint64_t key, std::vector<std::uint64_t>& selection);
+
+	void Scan(const std::int64_t* values, std::uint64_t count, Op op, std::int64_t key, std::vector<std::uint64_t>& selection);
+
+	namespace Kernel
+	{
+		// each kernel writes the matching indices of values[0, count) offset by base into out and returns how many it wrote,
+		// or returns UINT64_MAX when it was not compiled for this target
+		std::uint64_t Avx2(const std::uint64_t* values, std::uint64_t count, std::uint64_t base, Op op, std::uint64_t key, std::uint64_t* out);
+		std::uint64_t Avx2(const std::int64_t* values, std::uint64_t count, std::uint64_t base, Op op, std::int64_t key, std::uint64_t* out);
+
+		std::uint64_t Avx512(const std::uint64_t* values, std::uint64_t count, std::uint64_t base, Op op, std::uint64_t key, std::uint64_t* out);
+		std::uint64_t Avx512(const std::int64_t* values, std::uint64_t count, std::uint64_t base, Op op, std::int64_t key, std::uint64_t* out);
+
+		// internal linkage, every ISA translation unit gets its own copy instead of sharing one the linker picks
+		namespace
+		{
+			template<typename T>
+			std::uint64_t Scalar(const T* values, const std::uint64_t count, const std::uint64_t base, const Op op, const T key, std::uint64_t* out)
+			{
+				std::uint64_t n = 0;
+				switch (op)
+				{
+				case Op::Eq: for (std::uint64_t i = 0; i < count; ++i) { out[n] = base + i; n += values[i] == key; } break;
+				case Op::Lt: for (std::uint64_t i = 0; i < count; ++i) { out[n] = base + i; n += values[i] <  key; } break;
+				case Op::Gt: for (std::uint64_t i = 0; i < count; ++i) { out[n] = base + i; n += values[i] >  key; } break;
+				}
+				return n;
+			}
+		}
+	}
+}
@@ -0,0 +1,67 @@
+#include "ColumnScan.h"
+
+#include <limits>
+
+#if defined(__AVX2__) || (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)))
+
+#include <immintrin.h>
+
+namespace ColumnScan::Kernel
+{
+	template<bool Signed, typename T>
+	static std::uint64_t Avx2Impl(const T* values, const std::uint64_t count, const std::uint64_t base, const Op op, const T key, std::uint64_t* out)
+	{
+		// avx2 only has a signed 64-bit compare, unsigned values are compared with the sign bit flipped
+		const auto bias = _mm256_set1_epi64x(Signed ? 0 : std::numeric_limits<std::int64_t>::min());
+		const auto k = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<std::int64_t>(key)), bias);
+		std::uint64_t n = 0;
+		std::uint64_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const auto v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i)), bias);
+			__m256i m;
+			switch (op)
+			{
+			case Op::Eq: m = _mm256_cmpeq_epi64(v, k); break;
+			case Op::Lt: m = _mm256_cmpgt_epi64(k, v); break;
+			default:     m = _mm256_cmpgt_epi64(v, k); break;
+			}
+			auto bits = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+			while (bits != 0)
+			{
+				unsigned lane = 0;
+				while ((bits >> lane & 1u) == 0) ++lane;
+				out[n++] = base + i + lane;
+				bits &= bits - 1;
+			}
+		}
+		return n + Scalar(values + i, count - i, base + i, op, key, out + n);
+	}
+
+	std::uint64_t Avx2(const std::uint64_t* values, const std::uint64_t count, const std::uint64_t base, const Op op, const std::uint64_t key, std::uint64_t* out)
+	{
+		return Avx2Impl<false>(values, count, base, op, key, out);
+	}
+
+	std::uint64_t Avx2(const std::int64_t* values, const std::uint64_t count, const std::uint64_t base, const Op op, const std::int64_t key, std::uint64_t* out)
+	{
+		return Avx2Impl<true>(values, count, base, op, key, out);
+	}
+}
+
+#else
+
+namespace ColumnScan::Kernel
+{
+	std::uint64_t Avx2(const std::uint64_t*, std::uint64_t, std::uint64_t, Op, std::uint64_t, std::uint64_t*)
+	{
+		return std::numeric_limits<std::uint64_t>::max();
+	}
+
+	std::uint64_t Avx2(const std::int64_t*, std::uint64_t, std::uint64_t, Op, std::int64_t, std::uint64_t*)
+	{
+		return std::numeric_limits<std::uint64_t>::max();
+	}
+}
+
+#endif
@@ -0,0 +1,74 @@
+#include "ColumnScan.h"
+
+#include <limits>
+
+#if defined(__AVX512F__) || (defined(_MSC_VER) && defined(_M_X64))
+
+#include <immintrin.h>
+
+namespace ColumnScan::Kernel
+{
+	template<bool Signed, typename T>
+	static std::uint64_t Avx512Impl(const T* values, const std::uint64_t count, const std::uint64_t base, const Op op, const T key, std::uint64_t* out)
+	{
+		const auto k = _mm512_set1_epi64(static_cast<long long>(key));
+		const auto step = _mm512_set1_epi64(8);
+		auto index = _mm512_add_epi64(_mm512_set_epi64(7, 6, 5, 4, 3, 2, 1, 0), _mm512_set1_epi64(static_cast<long long>(base)));
+		std::uint64_t n = 0;
+		std::uint64_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const auto v = _mm512_loadu_si512(values + i);
+			__mmask8 m;
+			if constexpr (Signed)
+			{
+				switch (op)
+				{
+				case Op::Eq: m = _mm512_cmp_epi64_mask(v, k, _MM_CMPINT_EQ); break;
+				case Op::Lt: m = _mm512_cmp_epi64_mask(v, k, _MM_CMPINT_LT); break;
+				default:     m = _mm512_cmp_epi64_mask(v, k, _MM_CMPINT_NLE); break;
+				}
+			}
+			else
+			{
+				switch (op)
+				{
+				case Op::Eq: m = _mm512_cmp_epu64_mask(v, k, _MM_CMPINT_EQ); break;
+				case Op::Lt: m = _mm512_cmp_epu64_mask(v, k, _MM_CMPINT_LT); break;
+				default:     m = _mm512_cmp_epu64_mask(v, k, _MM_CMPINT_NLE); break;
+				}
+			}
+			_mm512_mask_compressstoreu_epi64(out + n, m, index);
+			n += static_cast<std::uint64_t>(_mm_popcnt_u32(m));
+			index = _mm512_add_epi64(index, step);
+		}
+		return n + Scalar(values + i, count - i, base + i, op, key, out + n);
+	}
+
+	std::uint64_t Avx512(const std::uint64_t* values, const std::uint64_t count, const std::uint64_t base, const Op op, const std::uint64_t key, std::uint64_t* out)
+	{
+		return Avx512Impl<false>(values, count, base, op, key, out);
+	}
+
+	std::uint64_t Avx512(const std::int64_t* values, const std::uint64_t count, const std::uint64_t base, const Op op, const std::int64_t key, std::uint64_t* out)
+	{
+		return Avx512Impl<true>(values, count, base, op, key, out);
+	}
+}
+
+#else
+
+namespace ColumnScan::Kernel
+{
+	std::uint64_t Avx512(const std::uint64_t*, std::uint64_t, std::uint64_t, Op, std::uint64_t, std::uint64_t*)
+	{
+		return std::numeric_limits<std::uint64_t>::max();
+	}
+
+	std::uint64_t Avx512(const std::int64_t*, std::uint64_t, std::uint64_t, Op, std::int64_t, std::uint64_t*)
+	{
+		return std::numeric_limits<std::uint64_t>::max();
+	}
+}
+
+#endif
@@ -0,0 +1,96 @@
+#include "Cpu.h"
+
+#include <array>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#include <immintrin.h>
+#define __Cpu_X86__
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define __Cpu_X86__
+#endif
+
+namespace Cpu
+{
+#ifdef __Cpu_X86__
+	namespace
+	{
+		struct Features
+		{
+			bool Sse2 = false;
+			bool Sse41 = false;
+			bool Avx2 = false;
+			bool Avx512 = false;
+			bool Sha = false;
+
+			Features()
+			{
+				const auto leaf1 = CpuId(1, 0);
+				const auto leaf7 = CpuId(0, 0)[0] >= 7 ? CpuId(7, 0) : std::array<std::uint32_t, 4>{};
+				const auto osxsave = (leaf1[2] >> 27 & 1) != 0;
+				const auto xcr0 = osxsave ? XGetBv() : 0;
+				const auto avxState = (xcr0 & 0x6) == 0x6;
+				const auto avx512State = (xcr0 & 0xe6) == 0xe6;
+
+				Sse2 = (leaf1[3] >> 26 & 1) != 0;
+				Sse41 = (leaf1[2] >> 19 & 1) != 0;
+				Avx2 = avxState && (leaf1[2] >> 28 & 1) != 0 && (leaf7[1] >> 5 & 1) != 0;
+				Avx512 = avx512State && (leaf7[1] >> 16 & 1) != 0;
+				Sha = Sse41 && (leaf7[1] >> 29 & 1) != 0;
+			}
+
+			static std::array<std::uint32_t, 4> CpuId(const std::uint32_t leaf, const std::uint32_t subLeaf)
+			{
+				std::array<std::uint32_t, 4> regs{};
+#ifdef _MSC_VER
+				int out[4]{};
+				__cpuidex(out, static_cast<int>(leaf), static_cast<int>(subLeaf));
+				for (auto i = 0; i < 4; ++i) regs[i] = static_cast<std::uint32_t>(out[i]);
+#else
+				__cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+				return regs;
+			}
+
+			static std::uint64_t XGetBv()
+			{
+#ifdef _MSC_VER
+				return _xgetbv(0);
+#else
+				std::uint32_t eax, edx;
+				__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+				return static_cast<std::uint64_t>(edx) << 32 | eax;
+#endif
+			}
+		};
+
+		const Features& Get()
+		{
+			static const Features features{};
+			return features;
+		}
+	}
+
+	bool Sse2() { return Get().Sse2; }
+
+	bool Sse41() { return Get().Sse41; }
+
+	bool Avx2() { return Get().Avx2; }
+
+	bool Avx512() { return Get().Avx512; }
+
+	bool Sha() { return Get().Sha; }
+#else
+	bool Sse2() { return false; }
+
+	bool Sse41() { return false; }
+
+	bool Avx2() { return false; }
+
+	bool Avx512() { return false; }
+
+	bool Sha() { return false; }
+#endif
+}
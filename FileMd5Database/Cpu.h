@@ -0,0 +1,14 @@
+#pragma once
+
+namespace Cpu
+{
+	bool Sse2();
+
+	bool Sse41();
+
+	bool Avx2();
+
+	bool Avx512();
+
+	bool Sha();
+}
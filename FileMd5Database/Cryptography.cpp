@@ -1,11 +1,16 @@
 #include "Cryptography.h"
 
-#include <charconv>
+#include <algorithm>
 #include <stdexcept>
 #include <climits>
 #include <cstring>
 #include <fstream>
+#include <memory>
 #include <type_traits>
+#include <variant>
+
+#include "Cpu.h"
+#include "Md5MultiBuffer.h"
 
 namespace Detail
 {
@@ -71,8 +76,8 @@ namespace Detail
 
 		constexpr std::uint32_t Get(const std::uint8_t* buf, const std::uint64_t index)
 		{
-			if constexpr (Endian::Native == Endian::Little) return       *(std::uint32_t*)&buf[index * 4];
-			if constexpr (Endian::Native == Endian::Big) return BSwap(*(std::uint32_t*)&buf[index * 4]);
+			if constexpr (Endian::Native == Endian::Little) return       *(const std::uint32_t*)&buf[index * 4];
+			if constexpr (Endian::Native == Endian::Big) return BSwap(*(const std::uint32_t*)&buf[index * 4]);
 		}
 	}
 }
@@ -81,7 +86,7 @@ namespace Cryptography
 {
 	Md5::Md5() : data({ {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476} }) {}
 
-	void Md5::Append(std::uint8_t* buf, std::uint64_t len)
+	void Md5::Append(const std::uint8_t* buf, std::uint64_t len)
 	{
 		if (finished) throw std::runtime_error("append error: finished");
 
@@ -90,10 +95,11 @@ namespace Cryptography
 			const std::uint64_t emp = 64u - bufferLen;
 			if (len < emp)
 			{
-				memcpy(buf + bufferLen, buf, len);
+				memcpy(buffer + bufferLen, buf, len);
+				bufferLen += static_cast<std::uint8_t>(len);
 				return;
 			}
-			memcpy(buf + bufferLen, buf, emp);
+			memcpy(buffer + bufferLen, buf, emp);
 			buf += emp;
 			len -= emp;
 			Append64(buffer, 1);
@@ -115,15 +121,38 @@ namespace Cryptography
 		if (finished) throw std::runtime_error("append error: finished");
 		if (stream.bad()) throw std::runtime_error("append error: bad stream");
 
+		constexpr std::streamsize bufSize = 64 * 1024;
+		const auto buf = std::make_unique<char[]>(bufSize);
 		while (!stream.eof())
 		{
-			char buf[4096]{ 0 };
-			stream.read(buf, 4096);
+			stream.read(buf.get(), bufSize);
 			const auto count = stream.gcount();
-			Append(reinterpret_cast<uint8_t*>(buf), count);
+			Append(reinterpret_cast<uint8_t*>(buf.get()), count);
 		}
 	}
 
+	void Md5::AppendZeros(std::uint64_t len)
+	{
+		if (finished) throw std::runtime_error("append error: finished");
+
+		if (bufferLen != 0)
+		{
+			const auto n = std::min<std::uint64_t>(len, 64u - bufferLen);
+			memset(buffer + bufferLen, 0, n);
+			bufferLen += static_cast<std::uint8_t>(n);
+			len -= n;
+			if (bufferLen < 64) return;
+			Append64(buffer, 1);
+			length += 64;
+			bufferLen = 0;
+		}
+
+		Compress<true>(nullptr, len >> 6u);
+		length += len & ~std::uint64_t{ 0x3f };
+		bufferLen = len & 0x3fu;
+		memset(buffer, 0, bufferLen);
+	}
+
 	Md5::DigestData Md5::Digest()
 	{
 		if (finished) return data;
@@ -159,23 +188,93 @@ namespace Cryptography
 	std::string Md5::HexDigest()
 	{
 		if (finished && !hexDigest.empty()) return hexDigest;
-		Digest();
-		std::string hex{};
-		hex.reserve(32);
-		for (unsigned char value : data.Word)
+		hexDigest = Hex(Digest());
+		return hexDigest;
+	}
+
+	std::string Md5::Hex(const DigestData& digest)
+	{
+		static constexpr char hexChars[] = "0123456789abcdef";
+		std::string hex(32, '0');
+		for (auto i = 0; i < 16; ++i)
+		{
+			hex[i * 2] = hexChars[digest.Word[i] >> 4u];
+			hex[i * 2 + 1] = hexChars[digest.Word[i] & 0xfu];
+		}
+		return hex;
+	}
+
+	bool Md5::FromHex(const std::string_view hex, DigestData& digest)
+	{
+		if (hex.length() != 32) return false;
+		const auto nibble = [](const char c) -> int
+		{
+			if (c >= '0' && c <= '9') return c - '0';
+			if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+			if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+			return -1;
+		};
+		for (auto i = 0; i < 16; ++i)
+		{
+			const auto hi = nibble(hex[i * 2]);
+			// older builds wrote bytes below 0x10 as "<digit>\0"
+			const auto lo = hex[i * 2 + 1] == '\0' ? -2 : nibble(hex[i * 2 + 1]);
+			if (hi < 0 || lo == -1) return false;
+			digest.Word[i] = static_cast<std::uint8_t>(lo == -2 ? hi : hi << 4 | lo);
+		}
+		return true;
+	}
+
+	std::string Digest::Hex(const Digest& digest)
+	{
+		static constexpr char hexChars[] = "0123456789abcdef";
+		std::string hex(digest.Len * 2u, '0');
+		for (std::size_t i = 0; i < digest.Len; ++i)
 		{
-			char res[4]{ '0', 0, 0, 0 };
-			if (auto [p, e] = std::to_chars(res + 1, res + 3, value, 16);
-				e != std::errc{}) throw std::runtime_error(std::string("convert error: ") + p);
-			hex.append(res[1] == 0 ? std::string_view(res, 2) : std::string_view(res + 1, 2));
+			hex[i * 2] = hexChars[digest.Word[i] >> 4u];
+			hex[i * 2 + 1] = hexChars[digest.Word[i] & 0xfu];
 		}
 		return hex;
 	}
 
-	void Md5::Append64(std::uint8_t* buf, std::uint64_t n)
+	bool Digest::FromHex(const std::string_view hex, Digest& digest)
+	{
+		if (hex.length() % 2 != 0 || hex.length() > MaxLen * 2) return false;
+		const auto nibble = [](const char c) -> int
+		{
+			if (c >= '0' && c <= '9') return c - '0';
+			if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+			if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+			return -1;
+		};
+		digest = {};
+		digest.Len = static_cast<std::uint8_t>(hex.length() / 2);
+		for (std::size_t i = 0; i < digest.Len; ++i)
+		{
+			const auto hi = nibble(hex[i * 2]);
+			const auto lo = nibble(hex[i * 2 + 1]);
+			if (hi < 0 || lo < 0) return false;
+			digest.Word[i] = static_cast<std::uint8_t>(hi << 4 | lo);
+		}
+		return true;
+	}
+
+	void Md5::Append64(const std::uint8_t* buf, const std::uint64_t n)
+	{
+		Compress<false>(buf, n);
+	}
+
+	template<bool Zero>
+	void Md5::Compress(const std::uint8_t* buf, std::uint64_t n)
 	{
 		using namespace Detail::Md5;
 		auto [a, b, c, d] = data.DWord;
+		// the message words of a zero block are constants and fold into the step constants
+		const auto x = [&](const std::uint64_t index) -> std::uint32_t
+		{
+			if constexpr (Zero) return 0;
+			else return Get(buf, index);
+		};
 
 		while (n--)
 		{
@@ -184,84 +283,168 @@ namespace Cryptography
 			const auto savedC = c;
 			const auto savedD = d;
 
-			Step<Roll::F>(a, b, c, d, Get(buf, 0), 0xd76aa478u, 7);
-			Step<Roll::F>(d, a, b, c, Get(buf, 1), 0xe8c7b756u, 12);
-			Step<Roll::F>(c, d, a, b, Get(buf, 2), 0x242070dbu, 17);
-			Step<Roll::F>(b, c, d, a, Get(buf, 3), 0xc1bdceeeu, 22);
-			Step<Roll::F>(a, b, c, d, Get(buf, 4), 0xf57c0fafu, 7);
-			Step<Roll::F>(d, a, b, c, Get(buf, 5), 0x4787c62au, 12);
-			Step<Roll::F>(c, d, a, b, Get(buf, 6), 0xa8304613u, 17);
-			Step<Roll::F>(b, c, d, a, Get(buf, 7), 0xfd469501u, 22);
-			Step<Roll::F>(a, b, c, d, Get(buf, 8), 0x698098d8u, 7);
-			Step<Roll::F>(d, a, b, c, Get(buf, 9), 0x8b44f7afu, 12);
-			Step<Roll::F>(c, d, a, b, Get(buf, 10), 0xffff5bb1u, 17);
-			Step<Roll::F>(b, c, d, a, Get(buf, 11), 0x895cd7beu, 22);
-			Step<Roll::F>(a, b, c, d, Get(buf, 12), 0x6b901122u, 7);
-			Step<Roll::F>(d, a, b, c, Get(buf, 13), 0xfd987193u, 12);
-			Step<Roll::F>(c, d, a, b, Get(buf, 14), 0xa679438eu, 17);
-			Step<Roll::F>(b, c, d, a, Get(buf, 15), 0x49b40821u, 22);
-
-			Step<Roll::G>(a, b, c, d, Get(buf, 1), 0xf61e2562u, 5);
-			Step<Roll::G>(d, a, b, c, Get(buf, 6), 0xc040b340u, 9);
-			Step<Roll::G>(c, d, a, b, Get(buf, 11), 0x265e5a51u, 14);
-			Step<Roll::G>(b, c, d, a, Get(buf, 0), 0xe9b6c7aau, 20);
-			Step<Roll::G>(a, b, c, d, Get(buf, 5), 0xd62f105du, 5);
-			Step<Roll::G>(d, a, b, c, Get(buf, 10), 0x02441453u, 9);
-			Step<Roll::G>(c, d, a, b, Get(buf, 15), 0xd8a1e681u, 14);
-			Step<Roll::G>(b, c, d, a, Get(buf, 4), 0xe7d3fbc8u, 20);
-			Step<Roll::G>(a, b, c, d, Get(buf, 9), 0x21e1cde6u, 5);
-			Step<Roll::G>(d, a, b, c, Get(buf, 14), 0xc33707d6u, 9);
-			Step<Roll::G>(c, d, a, b, Get(buf, 3), 0xf4d50d87u, 14);
-			Step<Roll::G>(b, c, d, a, Get(buf, 8), 0x455a14edu, 20);
-			Step<Roll::G>(a, b, c, d, Get(buf, 13), 0xa9e3e905u, 5);
-			Step<Roll::G>(d, a, b, c, Get(buf, 2), 0xfcefa3f8u, 9);
-			Step<Roll::G>(c, d, a, b, Get(buf, 7), 0x676f02d9u, 14);
-			Step<Roll::G>(b, c, d, a, Get(buf, 12), 0x8d2a4c8au, 20);
-
-			Step<Roll::H>(a, b, c, d, Get(buf, 5), 0xfffa3942u, 4);
-			Step<Roll::H>(d, a, b, c, Get(buf, 8), 0x8771f681u, 11);
-			Step<Roll::H>(c, d, a, b, Get(buf, 11), 0x6d9d6122u, 16);
-			Step<Roll::H>(b, c, d, a, Get(buf, 14), 0xfde5380cu, 23);
-			Step<Roll::H>(a, b, c, d, Get(buf, 1), 0xa4beea44u, 4);
-			Step<Roll::H>(d, a, b, c, Get(buf, 4), 0x4bdecfa9u, 11);
-			Step<Roll::H>(c, d, a, b, Get(buf, 7), 0xf6bb4b60u, 16);
-			Step<Roll::H>(b, c, d, a, Get(buf, 10), 0xbebfbc70u, 23);
-			Step<Roll::H>(a, b, c, d, Get(buf, 13), 0x289b7ec6u, 4);
-			Step<Roll::H>(d, a, b, c, Get(buf, 0), 0xeaa127fau, 11);
-			Step<Roll::H>(c, d, a, b, Get(buf, 3), 0xd4ef3085u, 16);
-			Step<Roll::H>(b, c, d, a, Get(buf, 6), 0x04881d05u, 23);
-			Step<Roll::H>(a, b, c, d, Get(buf, 9), 0xd9d4d039u, 4);
-			Step<Roll::H>(d, a, b, c, Get(buf, 12), 0xe6db99e5u, 11);
-			Step<Roll::H>(c, d, a, b, Get(buf, 15), 0x1fa27cf8u, 16);
-			Step<Roll::H>(b, c, d, a, Get(buf, 2), 0xc4ac5665u, 23);
-
-			Step<Roll::I>(a, b, c, d, Get(buf, 0), 0xf4292244u, 6);
-			Step<Roll::I>(d, a, b, c, Get(buf, 7), 0x432aff97u, 10);
-			Step<Roll::I>(c, d, a, b, Get(buf, 14), 0xab9423a7u, 15);
-			Step<Roll::I>(b, c, d, a, Get(buf, 5), 0xfc93a039u, 21);
-			Step<Roll::I>(a, b, c, d, Get(buf, 12), 0x655b59c3u, 6);
-			Step<Roll::I>(d, a, b, c, Get(buf, 3), 0x8f0ccc92u, 10);
-			Step<Roll::I>(c, d, a, b, Get(buf, 10), 0xffeff47du, 15);
-			Step<Roll::I>(b, c, d, a, Get(buf, 1), 0x85845dd1u, 21);
-			Step<Roll::I>(a, b, c, d, Get(buf, 8), 0x6fa87e4fu, 6);
-			Step<Roll::I>(d, a, b, c, Get(buf, 15), 0xfe2ce6e0u, 10);
-			Step<Roll::I>(c, d, a, b, Get(buf, 6), 0xa3014314u, 15);
-			Step<Roll::I>(b, c, d, a, Get(buf, 13), 0x4e0811a1u, 21);
-			Step<Roll::I>(a, b, c, d, Get(buf, 4), 0xf7537e82u, 6);
-			Step<Roll::I>(d, a, b, c, Get(buf, 11), 0xbd3af235u, 10);
-			Step<Roll::I>(c, d, a, b, Get(buf, 2), 0x2ad7d2bbu, 15);
-			Step<Roll::I>(b, c, d, a, Get(buf, 9), 0xeb86d391u, 21);
+			Step<Roll::F>(a, b, c, d, x(0), 0xd76aa478u, 7);
+			Step<Roll::F>(d, a, b, c, x(1), 0xe8c7b756u, 12);
+			Step<Roll::F>(c, d, a, b, x(2), 0x242070dbu, 17);
+			Step<Roll::F>(b, c, d, a, x(3), 0xc1bdceeeu, 22);
+			Step<Roll::F>(a, b, c, d, x(4), 0xf57c0fafu, 7);
+			Step<Roll::F>(d, a, b, c, x(5), 0x4787c62au, 12);
+			Step<Roll::F>(c, d, a, b, x(6), 0xa8304613u, 17);
+			Step<Roll::F>(b, c, d, a, x(7), 0xfd469501u, 22);
+			Step<Roll::F>(a, b, c, d, x(8), 0x698098d8u, 7);
+			Step<Roll::F>(d, a, b, c, x(9), 0x8b44f7afu, 12);
+			Step<Roll::F>(c, d, a, b, x(10), 0xffff5bb1u, 17);
+			Step<Roll::F>(b, c, d, a, x(11), 0x895cd7beu, 22);
+			Step<Roll::F>(a, b, c, d, x(12), 0x6b901122u, 7);
+			Step<Roll::F>(d, a, b, c, x(13), 0xfd987193u, 12);
+			Step<Roll::F>(c, d, a, b, x(14), 0xa679438eu, 17);
+			Step<Roll::F>(b, c, d, a, x(15), 0x49b40821u, 22);
+
+			Step<Roll::G>(a, b, c, d, x(1), 0xf61e2562u, 5);
+			Step<Roll::G>(d, a, b, c, x(6), 0xc040b340u, 9);
+			Step<Roll::G>(c, d, a, b, x(11), 0x265e5a51u, 14);
+			Step<Roll::G>(b, c, d, a, x(0), 0xe9b6c7aau, 20);
+			Step<Roll::G>(a, b, c, d, x(5), 0xd62f105du, 5);
+			Step<Roll::G>(d, a, b, c, x(10), 0x02441453u, 9);
+			Step<Roll::G>(c, d, a, b, x(15), 0xd8a1e681u, 14);
+			Step<Roll::G>(b, c, d, a, x(4), 0xe7d3fbc8u, 20);
+			Step<Roll::G>(a, b, c, d, x(9), 0x21e1cde6u, 5);
+			Step<Roll::G>(d, a, b, c, x(14), 0xc33707d6u, 9);
+			Step<Roll::G>(c, d, a, b, x(3), 0xf4d50d87u, 14);
+			Step<Roll::G>(b, c, d, a, x(8), 0x455a14edu, 20);
+			Step<Roll::G>(a, b, c, d, x(13), 0xa9e3e905u, 5);
+			Step<Roll::G>(d, a, b, c, x(2), 0xfcefa3f8u, 9);
+			Step<Roll::G>(c, d, a, b, x(7), 0x676f02d9u, 14);
+			Step<Roll::G>(b, c, d, a, x(12), 0x8d2a4c8au, 20);
+
+			Step<Roll::H>(a, b, c, d, x(5), 0xfffa3942u, 4);
+			Step<Roll::H>(d, a, b, c, x(8), 0x8771f681u, 11);
+			Step<Roll::H>(c, d, a, b, x(11), 0x6d9d6122u, 16);
+			Step<Roll::H>(b, c, d, a, x(14), 0xfde5380cu, 23);
+			Step<Roll::H>(a, b, c, d, x(1), 0xa4beea44u, 4);
+			Step<Roll::H>(d, a, b, c, x(4), 0x4bdecfa9u, 11);
+			Step<Roll::H>(c, d, a, b, x(7), 0xf6bb4b60u, 16);
+			Step<Roll::H>(b, c, d, a, x(10), 0xbebfbc70u, 23);
+			Step<Roll::H>(a, b, c, d, x(13), 0x289b7ec6u, 4);
+			Step<Roll::H>(d, a, b, c, x(0), 0xeaa127fau, 11);
+			Step<Roll::H>(c, d, a, b, x(3), 0xd4ef3085u, 16);
+			Step<Roll::H>(b, c, d, a, x(6), 0x04881d05u, 23);
+			Step<Roll::H>(a, b, c, d, x(9), 0xd9d4d039u, 4);
+			Step<Roll::H>(d, a, b, c, x(12), 0xe6db99e5u, 11);
+			Step<Roll::H>(c, d, a, b, x(15), 0x1fa27cf8u, 16);
+			Step<Roll::H>(b, c, d, a, x(2), 0xc4ac5665u, 23);
+
+			Step<Roll::I>(a, b, c, d, x(0), 0xf4292244u, 6);
+			Step<Roll::I>(d, a, b, c, x(7), 0x432aff97u, 10);
+			Step<Roll::I>(c, d, a, b, x(14), 0xab9423a7u, 15);
+			Step<Roll::I>(b, c, d, a, x(5), 0xfc93a039u, 21);
+			Step<Roll::I>(a, b, c, d, x(12), 0x655b59c3u, 6);
+			Step<Roll::I>(d, a, b, c, x(3), 0x8f0ccc92u, 10);
+			Step<Roll::I>(c, d, a, b, x(10), 0xffeff47du, 15);
+			Step<Roll::I>(b, c, d, a, x(1), 0x85845dd1u, 21);
+			Step<Roll::I>(a, b, c, d, x(8), 0x6fa87e4fu, 6);
+			Step<Roll::I>(d, a, b, c, x(15), 0xfe2ce6e0u, 10);
+			Step<Roll::I>(c, d, a, b, x(6), 0xa3014314u, 15);
+			Step<Roll::I>(b, c, d, a, x(13), 0x4e0811a1u, 21);
+			Step<Roll::I>(a, b, c, d, x(4), 0xf7537e82u, 6);
+			Step<Roll::I>(d, a, b, c, x(11), 0xbd3af235u, 10);
+			Step<Roll::I>(c, d, a, b, x(2), 0x2ad7d2bbu, 15);
+			Step<Roll::I>(b, c, d, a, x(9), 0xeb86d391u, 21);
 
 			a += savedA;
 			b += savedB;
 			c += savedC;
 			d += savedD;
 
-			buf += 64;
+			if constexpr (!Zero) buf += 64;
 		}
 		data.DWord.A = a;
 		data.DWord.B = b;
 		data.DWord.C = c;
 		data.DWord.D = d;
 	}
+
+	std::uint64_t Md5MultiBuffer::Lanes()
+	{
+		if constexpr (Detail::Endian::Native == Detail::Endian::Little)
+		{
+			if (Cpu::Avx512()) return 16;
+			if (Cpu::Avx2()) return 8;
+			if (Cpu::Sse2()) return 4;
+		}
+		return 1;
+	}
+
+	void Md5MultiBuffer::Hash(const std::vector<std::string_view>& messages, std::vector<Md5::DigestData>& digests)
+	{
+		digests.resize(messages.size());
+		if (messages.empty()) return;
+
+		const auto lanes = Lanes();
+		if (lanes == 16 && MultiBuffer::Md5Avx512(messages.data(), messages.size(), digests.data())) return;
+		if (lanes >= 8 && MultiBuffer::Md5Avx2(messages.data(), messages.size(), digests.data())) return;
+		if (lanes >= 4 && MultiBuffer::Md5Sse2(messages.data(), messages.size(), digests.data())) return;
+
+		for (std::size_t i = 0; i < messages.size(); ++i)
+		{
+			Md5 md5{};
+			md5.Append(reinterpret_cast<const std::uint8_t*>(messages[i].data()), messages[i].size());
+			digests[i] = md5.Digest();
+		}
+	}
+
+	Hasher::Hasher(const Algorithm algorithm) : state(std::in_place_type<Md5>)
+	{
+		switch (algorithm)
+		{
+		case Algorithm::Md5: break;
+		case Algorithm::Sha256: state.emplace<Sha256>(); break;
+		case Algorithm::Blake3: state.emplace<Blake3>(); break;
+		case Algorithm::Xxh64: state.emplace<Xxh64>(); break;
+		}
+	}
+
+	void Hasher::Append(const std::uint8_t* buf, const std::uint64_t len)
+	{
+		std::visit([&](auto& hash) { hash.Append(buf, len); }, state);
+	}
+
+	void Hasher::AppendZeros(std::uint64_t len)
+	{
+		if (auto* md5 = std::get_if<Md5>(&state)) return md5->AppendZeros(len);
+		static const std::uint8_t zeros[64 * 1024]{};
+		for (; len != 0; len -= std::min<std::uint64_t>(len, sizeof zeros))
+		{
+			Append(zeros, std::min<std::uint64_t>(len, sizeof zeros));
+		}
+	}
+
+	Cryptography::Digest Hasher::Digest(std::size_t len)
+	{
+		len = std::min(len, Cryptography::Digest::MaxLen);
+		Cryptography::Digest digest{};
+		digest.Len = static_cast<std::uint8_t>(len);
+		std::uint8_t data[Cryptography::Digest::MaxLen]{};
+		if (auto* md5 = std::get_if<Md5>(&state)) memcpy(data, md5->Digest().Word, sizeof(Md5::DigestData::Word));
+		if (auto* sha256 = std::get_if<Sha256>(&state))
+		{
+			const auto out = sha256->Digest();
+			memcpy(data, out.data(), out.size());
+		}
+		if (const auto* blake3 = std::get_if<Blake3>(&state)) blake3->Digest(data, Blake3::OutLen);
+		if (const auto* xxh64 = std::get_if<Xxh64>(&state))
+		{
+			// the canonical big endian form, as xxhsum prints it
+			const auto out = xxh64->Digest();
+			for (auto i = 0; i < 8; ++i) data[i] = static_cast<std::uint8_t>(out >> (56 - 8 * i));
+		}
+		memcpy(digest.Word, data, std::min(len, DigestLen(static_cast<Algorithm>(state.index()))));
+		return digest;
+	}
+
+	std::size_t Hasher::DigestLen(const Algorithm algorithm)
+	{
+		static constexpr std::size_t lens[]{ 16, 32, Blake3::OutLen, 8 };
+		return lens[static_cast<std::size_t>(algorithm)];
+	}
 }
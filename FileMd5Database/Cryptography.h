@@ -1,7 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <filesystem>
+#include <variant>
+#include <vector>
 
 namespace Cryptography
 {
@@ -11,15 +18,21 @@ namespace Cryptography
 		union DigestData
 		{
 			struct Integer { std::uint32_t A, B, C, D; } DWord;
+			std::uint64_t QWord[2];
 			std::uint8_t Word[16];
 		};
 
 		Md5();
-		void Append(std::uint8_t* buf, std::uint64_t len);
+		void Append(const std::uint8_t* buf, std::uint64_t len);
 		void Append(std::istream& stream);
+		// appends len zero bytes, whole zero blocks skip loading the message
+		void AppendZeros(std::uint64_t len);
 		[[maybe_unused]] DigestData Digest();
 		std::string HexDigest();
 
+		static std::string Hex(const DigestData& digest);
+		static bool FromHex(std::string_view hex, DigestData& digest);
+
 	private:
 		DigestData data;
 		std::uint8_t buffer[64]{ 0 };
@@ -29,6 +42,166 @@ namespace Cryptography
 		bool finished = false;
 		std::string hexDigest{};
 
-		void Append64(std::uint8_t* buf, std::uint64_t n);
+		void Append64(const std::uint8_t* buf, std::uint64_t n);
+		template<bool Zero>
+		void Compress(const std::uint8_t* buf, std::uint64_t n);
+	};
+
+	inline bool operator==(const Md5::DigestData& a, const Md5::DigestData& b)
+	{
+		return a.QWord[0] == b.QWord[0] && a.QWord[1] == b.QWord[1];
+	}
+
+	inline bool operator!=(const Md5::DigestData& a, const Md5::DigestData& b)
+	{
+		return !(a == b);
+	}
+
+	// byte-wise order, the same order as the hex strings
+	inline bool operator<(const Md5::DigestData& a, const Md5::DigestData& b)
+	{
+		const auto be = [](std::uint64_t x)
+		{
+#if defined(_MSC_VER) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+			x = (x & 0x00000000ffffffffull) << 32 | (x & 0xffffffff00000000ull) >> 32;
+			x = (x & 0x0000ffff0000ffffull) << 16 | (x & 0xffff0000ffff0000ull) >> 16;
+			x = (x & 0x00ff00ff00ff00ffull) << 8 | (x & 0xff00ff00ff00ff00ull) >> 8;
+#endif
+			return x;
+		};
+		return a.QWord[0] != b.QWord[0] ? be(a.QWord[0]) < be(b.QWord[0]) : be(a.QWord[1]) < be(b.QWord[1]);
+	}
+
+	inline bool operator>(const Md5::DigestData& a, const Md5::DigestData& b)
+	{
+		return b < a;
+	}
+
+	class Md5MultiBuffer
+	{
+	public:
+		static std::uint64_t Lanes();
+		static void Hash(const std::vector<std::string_view>& messages, std::vector<Md5::DigestData>& digests);
+	};
+
+	// compresses with SHA-NI when the cpu has it
+	class Sha256
+	{
+	public:
+		using DigestData = std::array<std::uint8_t, 32>;
+
+		Sha256();
+		void Append(const std::uint8_t* buf, std::uint64_t len);
+		DigestData Digest();
+
+	private:
+		std::uint32_t state[8]{};
+		std::uint8_t buffer[64]{ 0 };
+		std::uint8_t bufferLen = 0;
+		std::uint64_t length = 0;
+
+		bool finished = false;
+		DigestData data{};
+
+		void Compress(const std::uint8_t* blocks, std::uint64_t n);
+	};
+
+	// whole chunks of large appends are hashed several at a time with simd, big subtrees are split across threads
+	class Blake3
+	{
+	public:
+		static constexpr std::size_t OutLen = 32;
+		using DigestData = std::array<std::uint8_t, OutLen>;
+
+		Blake3();
+		void Append(const std::uint8_t* buf, std::uint64_t len);
+		// up to OutLen bytes, shorter outputs are prefixes of longer ones
+		void Digest(std::uint8_t* out, std::size_t len) const;
+		DigestData Digest() const;
+
+	private:
+		static constexpr std::size_t ChunkLen = 1024;
+		static constexpr std::size_t BlockLen = 64;
+		static constexpr std::size_t MaxDepth = 54;
+
+		struct Output
+		{
+			std::uint32_t Cv[8];
+			std::uint8_t Block[BlockLen];
+			std::uint8_t Length;
+			std::uint64_t Counter;
+			std::uint8_t Flags;
+		};
+
+		std::uint32_t chunkCv[8]{};
+		std::uint64_t chunkCounter = 0;
+		std::uint8_t block[BlockLen]{};
+		std::uint8_t blockLen = 0;
+		std::uint8_t blocksCompressed = 0;
+		std::uint32_t cvStack[MaxDepth][8]{};
+		std::uint8_t cvStackLen = 0;
+
+		[[nodiscard]] std::size_t ChunkBytes() const;
+		[[nodiscard]] std::uint8_t ChunkStart() const;
+		void ChunkUpdate(const std::uint8_t* buf, std::size_t len);
+		void ChunkReset(std::uint64_t counter);
+		[[nodiscard]] Output ChunkOutput() const;
+		void MergeStack(std::uint64_t totalChunks);
+		void PushCv(const std::uint32_t* cv, std::uint64_t counter);
+	};
+
+	// non-cryptographic, for telling files apart rather than proving them unmodified
+	class Xxh64
+	{
+	public:
+		explicit Xxh64(std::uint64_t seed = 0);
+		void Append(const std::uint8_t* buf, std::uint64_t len);
+		[[nodiscard]] std::uint64_t Digest() const;
+
+	private:
+		std::uint64_t seed;
+		std::uint64_t acc[4];
+		std::uint8_t buffer[32]{ 0 };
+		std::uint8_t bufferLen = 0;
+		std::uint64_t length = 0;
+	};
+
+	// a digest of any of the hashes, the bytes past Len are zero
+	struct Digest
+	{
+		static constexpr std::size_t MaxLen = 32;
+
+		std::uint8_t Word[MaxLen]{};
+		std::uint8_t Len = 0;
+
+		Digest() = default;
+		Digest(const std::uint8_t* data, const std::size_t len) : Len(static_cast<std::uint8_t>(std::min(len, MaxLen)))
+		{
+			memcpy(Word, data, Len);
+		}
+
+		static std::string Hex(const Digest& digest);
+		// an even number of hex digits, at most two per byte of MaxLen
+		static bool FromHex(std::string_view hex, Digest& digest);
+	};
+
+	// any of the hashes behind one interface
+	class Hasher
+	{
+	public:
+		enum class Algorithm : std::uint8_t { Md5, Sha256, Blake3, Xxh64 };
+
+		explicit Hasher(Algorithm algorithm);
+		void Append(const std::uint8_t* buf, std::uint64_t len);
+		// holes of sparse files, Md5 has a fast path for them
+		void AppendZeros(std::uint64_t len);
+		// the first len bytes of the digest, zero padded past the output of the algorithm
+		Cryptography::Digest Digest(std::size_t len);
+
+		// bytes of the whole output of algorithm
+		static std::size_t DigestLen(Algorithm algorithm);
+
+	private:
+		std::variant<Md5, Sha256, Blake3, Xxh64> state;
 	};
 }
@@ -0,0 +1,884 @@
+#include "File.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "Macro.h"
+
+#ifdef MacroWindows
+#define NOMINMAX
+#include <Windows.h>
+#include <winioctl.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+#endif
+
+namespace File
+{
+#ifdef MacroWindows
+	MemoryMap::MemoryMap(const std::filesystem::path& path)
+	{
+		file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("open error: " + path.u8string());
+		LARGE_INTEGER fileSize{};
+		GetFileSizeEx(file, &fileSize);
+		size = static_cast<std::uint64_t>(fileSize.QuadPart);
+		if (size == 0) return;
+		mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+		{
+			CloseHandle(file);
+			throw std::runtime_error("mmap error: " + path.u8string());
+		}
+		data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (data == nullptr)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			throw std::runtime_error("mmap error: " + path.u8string());
+		}
+	}
+
+	void Sync(const std::filesystem::path& path)
+	{
+		const auto file = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("open error: " + path.u8string());
+		const auto ok = FlushFileBuffers(file);
+		CloseHandle(file);
+		if (!ok) throw std::runtime_error("sync error: " + path.u8string());
+	}
+
+	void SyncDirectory(const std::filesystem::path& path)
+	{
+		// directory handles need backup semantics, file systems that cannot flush them commit renames on their own
+		const auto dir = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+		if (dir == INVALID_HANDLE_VALUE) return;
+		FlushFileBuffers(dir);
+		CloseHandle(dir);
+	}
+
+	MemoryMap::~MemoryMap()
+	{
+		if (data != nullptr) UnmapViewOfFile(data);
+		if (mapping != nullptr) CloseHandle(mapping);
+		if (file != nullptr && file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	}
+#else
+	MemoryMap::MemoryMap(const std::filesystem::path& path)
+	{
+		const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) throw std::runtime_error("open error: " + path.u8string());
+		struct stat st {};
+		if (fstat(fd, &st) != 0)
+		{
+			close(fd);
+			throw std::runtime_error("stat error: " + path.u8string());
+		}
+		size = static_cast<std::uint64_t>(st.st_size);
+		if (size != 0)
+		{
+			auto* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (addr == MAP_FAILED)
+			{
+				close(fd);
+				throw std::runtime_error("mmap error: " + path.u8string());
+			}
+			madvise(addr, size, MADV_WILLNEED);
+			data = static_cast<const char*>(addr);
+		}
+		close(fd);
+	}
+
+	void Sync(const std::filesystem::path& path)
+	{
+		const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) throw std::runtime_error("open error: " + path.u8string());
+		const auto res = fsync(fd);
+		close(fd);
+		if (res != 0) throw std::runtime_error("sync error: " + path.u8string());
+	}
+
+	void SyncDirectory(const std::filesystem::path& path)
+	{
+		const auto fd = open(path.empty() ? "." : path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (fd < 0) throw std::runtime_error("open error: " + path.u8string());
+		const auto res = fsync(fd);
+		close(fd);
+		if (res != 0) throw std::runtime_error("sync error: " + path.u8string());
+	}
+
+	MemoryMap::~MemoryMap()
+	{
+		if (data != nullptr) munmap(const_cast<char*>(data), size);
+	}
+#endif
+
+#ifdef MacroWindows
+	static std::filesystem::path LongPath(const std::filesystem::path& path)
+	{
+		const auto str = path.native();
+		if (!path.is_absolute() || str.rfind(LR"(\\?\)", 0) == 0) return path;
+		return LR"(\\?\)" + str;
+	}
+
+	std::optional<Status> GetStatus(const std::filesystem::path& path)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA data{};
+		if (!GetFileAttributesExW(LongPath(path).c_str(), GetFileExInfoStandard, &data)) return std::nullopt;
+		Status status{};
+		status.Type = data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT ? EntryType::Symlink
+			: data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ? EntryType::Directory
+			: EntryType::Regular;
+		status.Size = static_cast<std::uint64_t>(data.nFileSizeHigh) << 32 | data.nFileSizeLow;
+		// FILETIME counts 100ns ticks since 1601-01-01
+		const auto ticks = static_cast<std::int64_t>(static_cast<std::uint64_t>(data.ftLastWriteTime.dwHighDateTime) << 32 | data.ftLastWriteTime.dwLowDateTime);
+		const auto seconds = ticks / 10000000 - 11644473600;
+		status.ModifiedTime = ticks < 0 && ticks % 10000000 != 0 ? seconds - 1 : seconds;
+		return status;
+	}
+
+	Directory::Directory(std::filesystem::path path) : path(std::move(path))
+	{
+		if (!is_directory(LongPath(this->path))) throw std::runtime_error("open error: " + this->path.u8string());
+		++openCount;
+	}
+
+	Directory::~Directory()
+	{
+		--openCount;
+	}
+
+	void Directory::List(const std::function<void(const std::string& name, EntryType type)>& func) const
+	{
+		for (const auto& entry : std::filesystem::directory_iterator(LongPath(path)))
+		{
+			std::error_code ec{};
+			const auto st = entry.symlink_status(ec);
+			const auto type = ec ? EntryType::Unknown
+				: is_symlink(st) ? EntryType::Symlink
+				: is_regular_file(st) ? EntryType::Regular
+				: is_directory(st) ? EntryType::Directory
+				: EntryType::Other;
+			func(entry.path().filename().u8string(), type);
+		}
+	}
+
+	std::optional<Status> Directory::GetStatus(const std::string& name) const
+	{
+		return File::GetStatus(path / std::filesystem::u8path(name));
+	}
+
+	static void* OpenRead(const std::filesystem::path& path, const CacheMode mode)
+	{
+		const DWORD flags = FILE_FLAG_SEQUENTIAL_SCAN | (mode == CacheMode::Direct ? FILE_FLAG_NO_BUFFERING : 0);
+		return CreateFileW(LongPath(path).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, flags, nullptr);
+	}
+
+	Reader::Reader(const std::filesystem::path& path, const CacheMode mode) : path(path), mode(mode)
+	{
+		file = OpenRead(path, mode);
+		if (file == INVALID_HANDLE_VALUE) throw std::runtime_error("open error: " + path.u8string());
+	}
+
+	Reader::Reader(const Directory& dir, const std::string& name, const CacheMode mode) : Reader(dir.Path() / std::filesystem::u8path(name), mode) {}
+
+	Reader::~Reader()
+	{
+		if (file != nullptr && file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	}
+
+	std::uint64_t Reader::Read(char* buffer, const std::uint64_t len)
+	{
+		BeforeRead(buffer, len, position);
+		DWORD n = 0;
+		if (!ReadFile(file, buffer, static_cast<DWORD>(std::min<std::uint64_t>(len, 1u << 30)), &n, nullptr)) throw std::runtime_error("read error: " + path.u8string());
+		position += n;
+		return n;
+	}
+
+	std::uint64_t Reader::ReadAt(char* buffer, const std::uint64_t len, const std::uint64_t offset)
+	{
+		BeforeRead(buffer, len, offset);
+		// synchronous handles move their position on positioned reads too, so it is put back afterwards
+		LARGE_INTEGER pos{};
+		if (!SetFilePointerEx(file, {}, &pos, FILE_CURRENT)) throw std::runtime_error("seek error: " + path.u8string());
+		OVERLAPPED overlapped{};
+		overlapped.Offset = static_cast<DWORD>(offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+		DWORD n = 0;
+		if (!ReadFile(file, buffer, static_cast<DWORD>(std::min<std::uint64_t>(len, 1u << 30)), &n, &overlapped) && GetLastError() != ERROR_HANDLE_EOF)
+			throw std::runtime_error("read error: " + path.u8string());
+		SetFilePointerEx(file, pos, nullptr, FILE_BEGIN);
+		return n;
+	}
+
+	void Reader::BeforeRead(const char* buffer, const std::uint64_t len, const std::uint64_t offset)
+	{
+		if (mode != CacheMode::Direct) return;
+		if (reinterpret_cast<std::uintptr_t>(buffer) % DirectAlignment == 0 && len % DirectAlignment == 0 && offset % DirectAlignment == 0) return;
+		// a buffered handle takes over at the same position
+		auto* buffered = OpenRead(path, CacheMode::Buffered);
+		if (buffered == INVALID_HANDLE_VALUE) throw std::runtime_error("open error: " + path.u8string());
+		CloseHandle(file);
+		file = buffered;
+		LARGE_INTEGER pos{};
+		pos.QuadPart = static_cast<LONGLONG>(position);
+		SetFilePointerEx(file, pos, nullptr, FILE_BEGIN);
+		mode = CacheMode::Buffered;
+	}
+
+	// windows has no advice to drop cached pages, DropBehind only announces sequential reads there
+	void Reader::AfterRead(std::uint64_t, std::uint64_t) {}
+
+	// the cache manager reads ahead of sequential reads on its own
+	void Reader::Prefetch(std::uint64_t, std::uint64_t) {}
+
+	std::vector<std::pair<std::uint64_t, std::uint64_t>> Reader::DataRanges(const std::uint64_t size)
+	{
+		std::vector<std::pair<std::uint64_t, std::uint64_t>> ranges{};
+		FILE_ALLOCATED_RANGE_BUFFER query{};
+		query.Length.QuadPart = static_cast<LONGLONG>(size);
+		FILE_ALLOCATED_RANGE_BUFFER allocated[64]{};
+		while (query.Length.QuadPart > 0)
+		{
+			DWORD bytes = 0;
+			const auto ok = DeviceIoControl(file, FSCTL_QUERY_ALLOCATED_RANGES, &query, sizeof query, allocated, sizeof allocated, &bytes, nullptr);
+			if (!ok && GetLastError() != ERROR_MORE_DATA) return { { 0, size } };
+			const auto count = bytes / sizeof allocated[0];
+			if (count == 0) break;
+			for (std::size_t i = 0; i < count; ++i)
+			{
+				const auto offset = static_cast<std::uint64_t>(allocated[i].FileOffset.QuadPart);
+				const auto end = std::min(offset + static_cast<std::uint64_t>(allocated[i].Length.QuadPart), size);
+				if (offset < end) ranges.emplace_back(offset, end - offset);
+			}
+			if (ok) break;
+			const auto next = ranges.empty() ? size : ranges.back().first + ranges.back().second;
+			query.FileOffset.QuadPart = static_cast<LONGLONG>(next);
+			query.Length.QuadPart = static_cast<LONGLONG>(size - next);
+		}
+		return ranges;
+	}
+
+	std::optional<std::uint64_t> Reader::FirstExtent()
+	{
+		STARTING_VCN_INPUT_BUFFER input{};
+		RETRIEVAL_POINTERS_BUFFER output{};
+		DWORD bytes = 0;
+		if (!DeviceIoControl(file, FSCTL_GET_RETRIEVAL_POINTERS, &input, sizeof input, &output, sizeof output, &bytes, nullptr) && GetLastError() != ERROR_MORE_DATA) return std::nullopt;
+		// resident, compressed or sparse runs have no cluster
+		if (output.ExtentCount == 0 || output.Extents[0].Lcn.QuadPart < 0) return std::nullopt;
+		return static_cast<std::uint64_t>(output.Extents[0].Lcn.QuadPart);
+	}
+#else
+	static EntryType ModeToEntryType(const mode_t mode)
+	{
+		if (S_ISREG(mode)) return EntryType::Regular;
+		if (S_ISDIR(mode)) return EntryType::Directory;
+		if (S_ISLNK(mode)) return EntryType::Symlink;
+		return EntryType::Other;
+	}
+
+	static std::optional<Status> GetStatusAt(const int dirFd, const char* name, const bool follow)
+	{
+#if defined(__linux__) && defined(STATX_INO)
+		// one statx for everything the builder needs, without syncing remote attributes
+		struct statx st {};
+		if (statx(dirFd, name, (follow ? 0 : AT_SYMLINK_NOFOLLOW) | AT_NO_AUTOMOUNT | AT_STATX_DONT_SYNC, STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_INO | STATX_NLINK, &st) != 0) return std::nullopt;
+		return Status{ ModeToEntryType(st.stx_mode), st.stx_size, st.stx_mtime.tv_sec, makedev(st.stx_dev_major, st.stx_dev_minor), st.stx_ino, st.stx_nlink };
+#else
+		struct stat st {};
+		if (fstatat(dirFd, name, &st, follow ? 0 : AT_SYMLINK_NOFOLLOW) != 0) return std::nullopt;
+		return Status{ ModeToEntryType(st.st_mode), static_cast<std::uint64_t>(st.st_size), static_cast<std::int64_t>(st.st_mtime), static_cast<std::uint64_t>(st.st_dev), static_cast<std::uint64_t>(st.st_ino), static_cast<std::uint64_t>(st.st_nlink) };
+#endif
+	}
+
+	static EntryType DirentToEntryType(const unsigned char type)
+	{
+		switch (type)
+		{
+		case DT_REG: return EntryType::Regular;
+		case DT_DIR: return EntryType::Directory;
+		case DT_LNK: return EntryType::Symlink;
+		case DT_UNKNOWN: return EntryType::Unknown;
+		default: return EntryType::Other;
+		}
+	}
+
+	std::optional<Status> GetStatus(const std::filesystem::path& path)
+	{
+		return GetStatusAt(AT_FDCWD, path.c_str(), true);
+	}
+
+	Directory::Directory(std::filesystem::path path) : path(std::move(path))
+	{
+		fd = open(this->path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (fd < 0) throw std::runtime_error("open error: " + this->path.u8string() + ": " + strerror(errno));
+		++openCount;
+	}
+
+	Directory::~Directory()
+	{
+		close(fd);
+		--openCount;
+	}
+
+	void Directory::List(const std::function<void(const std::string& name, EntryType type)>& func) const
+	{
+		std::string name{};
+#ifdef __linux__
+		// linux_dirent64: u64 d_ino, s64 d_off, u16 d_reclen, u8 d_type, char d_name[]
+		constexpr std::size_t reclenOffset = 16;
+		constexpr std::size_t typeOffset = 18;
+		constexpr std::size_t nameOffset = 19;
+		alignas(8) char buffer[32 * 1024];
+		while (true)
+		{
+			const auto n = syscall(SYS_getdents64, fd, buffer, sizeof buffer);
+			if (n < 0)
+			{
+				if (errno == EINTR) continue;
+				throw std::runtime_error("list error: " + path.u8string() + ": " + strerror(errno));
+			}
+			if (n == 0) break;
+			for (long offset = 0; offset < n;)
+			{
+				const auto* entry = buffer + offset;
+				unsigned short reclen = 0;
+				memcpy(&reclen, entry + reclenOffset, sizeof reclen);
+				offset += reclen;
+				name.assign(entry + nameOffset);
+				if (name == "." || name == "..") continue;
+				func(name, DirentToEntryType(static_cast<unsigned char>(entry[typeOffset])));
+			}
+		}
+#else
+		const auto dirFd = dup(fd);
+		if (dirFd < 0) throw std::runtime_error("list error: " + path.u8string() + ": " + strerror(errno));
+		auto* dir = fdopendir(dirFd);
+		if (dir == nullptr)
+		{
+			close(dirFd);
+			throw std::runtime_error("list error: " + path.u8string() + ": " + strerror(errno));
+		}
+		while (const auto* entry = readdir(dir))
+		{
+			name.assign(entry->d_name);
+			if (name == "." || name == "..") continue;
+#ifdef _DIRENT_HAVE_D_TYPE
+			func(name, DirentToEntryType(entry->d_type));
+#else
+			func(name, EntryType::Unknown);
+#endif
+		}
+		closedir(dir);
+#endif
+	}
+
+	std::optional<Status> Directory::GetStatus(const std::string& name) const
+	{
+		return GetStatusAt(fd, name.c_str(), false);
+	}
+
+	// Direct falls back to Buffered on file systems refusing O_DIRECT
+	static int OpenRead(const int dir, const char* name, CacheMode& mode)
+	{
+#ifdef O_DIRECT
+		if (mode == CacheMode::Direct)
+		{
+			const auto fd = openat(dir, name, O_RDONLY | O_CLOEXEC | O_DIRECT);
+			if (fd >= 0 || errno != EINVAL) return fd;
+		}
+#endif
+		if (mode == CacheMode::Direct) mode = CacheMode::Buffered;
+		const auto fd = openat(dir, name, O_RDONLY | O_CLOEXEC);
+#ifdef POSIX_FADV_SEQUENTIAL
+		if (fd >= 0 && mode == CacheMode::DropBehind) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+		return fd;
+	}
+
+	Reader::Reader(const std::filesystem::path& path, const CacheMode mode) : path(path), mode(mode)
+	{
+		fd = OpenRead(AT_FDCWD, path.c_str(), this->mode);
+		if (fd < 0) throw std::runtime_error("open error: " + path.u8string() + ": " + strerror(errno));
+	}
+
+	Reader::Reader(const Directory& dir, const std::string& name, const CacheMode mode) : path(dir.Path() / name), mode(mode)
+	{
+		fd = OpenRead(dir.fd, name.c_str(), this->mode);
+		if (fd < 0) throw std::runtime_error("open error: " + path.u8string() + ": " + strerror(errno));
+	}
+
+	Reader::~Reader()
+	{
+		if (fd >= 0) close(fd);
+	}
+
+	std::uint64_t Reader::Read(char* buffer, const std::uint64_t len)
+	{
+		BeforeRead(buffer, len, position);
+		while (true)
+		{
+			const auto n = read(fd, buffer, len);
+			if (n >= 0)
+			{
+				AfterRead(position, static_cast<std::uint64_t>(n));
+				position += static_cast<std::uint64_t>(n);
+				return static_cast<std::uint64_t>(n);
+			}
+			if (errno != EINTR) throw std::runtime_error("read error: " + path.u8string() + ": " + strerror(errno));
+		}
+	}
+
+	std::uint64_t Reader::ReadAt(char* buffer, const std::uint64_t len, const std::uint64_t offset)
+	{
+		BeforeRead(buffer, len, offset);
+		while (true)
+		{
+			const auto n = pread(fd, buffer, len, static_cast<off_t>(offset));
+			if (n >= 0)
+			{
+				AfterRead(offset, static_cast<std::uint64_t>(n));
+				return static_cast<std::uint64_t>(n);
+			}
+			if (errno != EINTR) throw std::runtime_error("read error: " + path.u8string() + ": " + strerror(errno));
+		}
+	}
+
+	void Reader::BeforeRead(const char* buffer, const std::uint64_t len, const std::uint64_t offset)
+	{
+#ifdef O_DIRECT
+		if (mode != CacheMode::Direct) return;
+		if (reinterpret_cast<std::uintptr_t>(buffer) % DirectAlignment == 0 && len % DirectAlignment == 0 && offset % DirectAlignment == 0) return;
+		if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT) != 0) throw std::runtime_error("fcntl error: " + path.u8string() + ": " + strerror(errno));
+		mode = CacheMode::Buffered;
+#endif
+	}
+
+	void Reader::AfterRead(const std::uint64_t offset, const std::uint64_t len)
+	{
+#ifdef POSIX_FADV_DONTNEED
+		if (mode == CacheMode::DropBehind && len != 0) posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(len), POSIX_FADV_DONTNEED);
+#endif
+	}
+
+	void Reader::Prefetch(const std::uint64_t offset, const std::uint64_t len)
+	{
+#ifdef POSIX_FADV_WILLNEED
+		if (mode != CacheMode::Direct && len != 0) posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(len), POSIX_FADV_WILLNEED);
+#endif
+	}
+
+	std::vector<std::pair<std::uint64_t, std::uint64_t>> Reader::DataRanges(const std::uint64_t size)
+	{
+		std::vector<std::pair<std::uint64_t, std::uint64_t>> ranges{};
+#ifdef SEEK_DATA
+		const auto current = lseek(fd, 0, SEEK_CUR);
+		std::uint64_t pos = 0;
+		while (pos < size)
+		{
+			const auto data = lseek(fd, static_cast<off_t>(pos), SEEK_DATA);
+			if (data < 0 && errno == ENXIO) break;
+			const auto hole = data < 0 ? data : lseek(fd, data, SEEK_HOLE);
+			if (hole < 0)
+			{
+				// EINVAL where the file system has no hole support
+				ranges = { { 0, size } };
+				break;
+			}
+			if (static_cast<std::uint64_t>(data) >= size) break;
+			const auto end = std::min(static_cast<std::uint64_t>(hole), size);
+			ranges.emplace_back(static_cast<std::uint64_t>(data), end - static_cast<std::uint64_t>(data));
+			pos = end;
+		}
+		// Read continues from where it was
+		lseek(fd, current, SEEK_SET);
+#else
+		ranges = { { 0, size } };
+#endif
+		return ranges;
+	}
+
+	std::optional<std::uint64_t> Reader::FirstExtent()
+	{
+#if defined(__linux__) && defined(FS_IOC_FIEMAP)
+		alignas(fiemap) char buffer[sizeof(fiemap) + sizeof(fiemap_extent)]{};
+		auto* map = reinterpret_cast<fiemap*>(buffer);
+		map->fm_length = FIEMAP_MAX_OFFSET;
+		map->fm_extent_count = 1;
+		if (ioctl(fd, FS_IOC_FIEMAP, map) != 0 || map->fm_mapped_extents == 0) return std::nullopt;
+		if (map->fm_extents[0].fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DATA_INLINE)) return std::nullopt;
+		return map->fm_extents[0].fe_physical;
+#else
+		return std::nullopt;
+#endif
+	}
+#endif
+
+#if defined(__linux__) && defined(IORING_SETUP_SUBMIT_ALL)
+	// a minimal io_uring without liburing, every file is an openat into a direct descriptor slot linked to a read and a close
+	struct BatchReader::Ring
+	{
+		enum Op : std::uint64_t { OpenOp, ReadOp, AdviseOp, CloseOp, OpCount };
+
+		CacheMode mode = CacheMode::Buffered;
+		// submissions per file, AdviseOp only drops behind
+		std::uint32_t ops = OpCount - 1;
+
+		int fd = -1;
+		void* sqRing = MAP_FAILED;
+		std::size_t sqRingLen = 0;
+		void* cqRing = MAP_FAILED;
+		std::size_t cqRingLen = 0;
+		io_uring_sqe* sqes = nullptr;
+		std::size_t sqesLen = 0;
+		unsigned* sqTail = nullptr;
+		unsigned sqMask = 0;
+		unsigned* sqArray = nullptr;
+		unsigned* cqHead = nullptr;
+		unsigned* cqTail = nullptr;
+		unsigned cqMask = 0;
+		io_uring_cqe* cqes = nullptr;
+		unsigned tail = 0;
+
+		~Ring()
+		{
+			if (sqes != nullptr) munmap(sqes, sqesLen);
+			if (cqRing != MAP_FAILED && cqRing != sqRing) munmap(cqRing, cqRingLen);
+			if (sqRing != MAP_FAILED) munmap(sqRing, sqRingLen);
+			if (fd >= 0) close(fd);
+		}
+
+		// nullptr when the kernel lacks io_uring, direct descriptors or SUBMIT_ALL (5.18), or it is disabled
+		static std::unique_ptr<Ring> Create(const std::uint32_t slots, const CacheMode mode)
+		{
+			auto ring = std::make_unique<Ring>();
+			ring->mode = mode;
+			ring->ops = mode == CacheMode::DropBehind ? OpCount : OpCount - 1;
+			io_uring_params params{};
+			params.flags = IORING_SETUP_SUBMIT_ALL;
+			ring->fd = static_cast<int>(syscall(__NR_io_uring_setup, slots * OpCount, &params));
+			if (ring->fd < 0 || !(params.features & IORING_FEAT_SINGLE_MMAP)) return nullptr;
+
+			ring->sqRingLen = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+			ring->cqRingLen = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+			ring->sqRingLen = ring->cqRingLen = std::max(ring->sqRingLen, ring->cqRingLen);
+			ring->sqRing = mmap(nullptr, ring->sqRingLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+			if (ring->sqRing == MAP_FAILED) return nullptr;
+			ring->cqRing = ring->sqRing;
+			ring->sqesLen = params.sq_entries * sizeof(io_uring_sqe);
+			auto* sqes = mmap(nullptr, ring->sqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+			if (sqes == MAP_FAILED) return nullptr;
+			ring->sqes = static_cast<io_uring_sqe*>(sqes);
+
+			auto* sq = static_cast<char*>(ring->sqRing);
+			ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+			ring->sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+			ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+			ring->cqHead = reinterpret_cast<unsigned*>(sq + params.cq_off.head);
+			ring->cqTail = reinterpret_cast<unsigned*>(sq + params.cq_off.tail);
+			ring->cqMask = *reinterpret_cast<unsigned*>(sq + params.cq_off.ring_mask);
+			ring->cqes = reinterpret_cast<io_uring_cqe*>(sq + params.cq_off.cqes);
+			ring->tail = *ring->sqTail;
+
+			// an empty slot per file in flight
+			const std::vector<int> files(slots, -1);
+			if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_FILES, files.data(), slots) < 0) return nullptr;
+			return ring;
+		}
+
+		io_uring_sqe& Next(const Op op, const std::uint32_t slot, const std::uint8_t flags)
+		{
+			const auto index = tail++ & sqMask;
+			sqArray[index] = index;
+			auto& sqe = sqes[index];
+			memset(&sqe, 0, sizeof sqe);
+			sqe.flags = flags;
+			sqe.user_data = slot * OpCount + op;
+			return sqe;
+		}
+
+		// direct reads go to an aligned buffer of len, a multiple of DirectAlignment
+		void Prepare(const std::uint32_t slot, const Request& request, char* data, const std::uint64_t len)
+		{
+			auto& openSqe = Next(OpenOp, slot, IOSQE_IO_LINK);
+			openSqe.opcode = IORING_OP_OPENAT;
+			openSqe.fd = request.Dir != nullptr ? request.Dir->fd : AT_FDCWD;
+			openSqe.addr = reinterpret_cast<std::uint64_t>(request.Dir != nullptr ? request.Name.c_str() : request.Path.c_str());
+			// direct descriptors do not take O_CLOEXEC, they never reach the process file table
+			openSqe.open_flags = O_RDONLY | (mode == CacheMode::Direct ? O_DIRECT : 0);
+			openSqe.file_index = slot + 1;
+
+			// the close runs even when the read fails or comes up short
+			auto& readSqe = Next(ReadOp, slot, IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK);
+			readSqe.opcode = IORING_OP_READ;
+			readSqe.fd = static_cast<int>(slot);
+			readSqe.addr = reinterpret_cast<std::uint64_t>(data);
+			readSqe.len = static_cast<std::uint32_t>(len);
+
+			if (mode == CacheMode::DropBehind)
+			{
+				auto& adviseSqe = Next(AdviseOp, slot, IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK);
+				adviseSqe.opcode = IORING_OP_FADVISE;
+				adviseSqe.fd = static_cast<int>(slot);
+				adviseSqe.fadvise_advice = POSIX_FADV_DONTNEED;
+			}
+
+			auto& closeSqe = Next(CloseOp, slot, 0);
+			closeSqe.opcode = IORING_OP_CLOSE;
+			closeSqe.file_index = slot + 1;
+		}
+
+		void Submit(const unsigned count, const unsigned wait)
+		{
+			__atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+			while (syscall(__NR_io_uring_enter, fd, count, wait, IORING_ENTER_GETEVENTS, nullptr, 0) < 0)
+			{
+				if (errno != EINTR) throw std::runtime_error(std::string("io_uring error: ") + strerror(errno));
+			}
+		}
+
+		template<typename Func>
+		void Reap(Func&& func)
+		{
+			auto head = *cqHead;
+			const auto end = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+			for (; head != end; ++head)
+			{
+				const auto& cqe = cqes[head & cqMask];
+				func(static_cast<std::uint32_t>(cqe.user_data / OpCount), static_cast<Op>(cqe.user_data % OpCount), cqe.res);
+			}
+			__atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+		}
+	};
+#else
+	struct BatchReader::Ring
+	{
+		static std::unique_ptr<Ring> Create(std::uint32_t, CacheMode) { return nullptr; }
+	};
+#endif
+
+	BatchReader::BatchReader(const std::uint32_t queueDepth, const CacheMode mode) :
+		queueDepth(std::min(queueDepth, MaxQueueDepth)),
+		mode(mode),
+		ring(queueDepth == 0 ? nullptr : Ring::Create(this->queueDepth, mode)) {}
+
+	BatchReader::~BatchReader() = default;
+
+	void BatchReader::Read(const std::vector<Request>& requests, std::vector<std::string>& contents, std::vector<std::string>& errors)
+	{
+		contents.assign(requests.size(), {});
+		errors.assign(requests.size(), {});
+		for (std::size_t i = 0; i < requests.size(); ++i) contents[i].resize(requests[i].Size);
+
+		const auto readBlocking = [&](const std::size_t i)
+		{
+			const auto& request = requests[i];
+			auto& data = contents[i];
+			try
+			{
+				const auto reader = request.Dir != nullptr ? std::make_unique<Reader>(*request.Dir, request.Name, mode) : std::make_unique<Reader>(request.Path, mode);
+				std::uint64_t len = 0;
+				while (len < data.size())
+				{
+					const auto n = reader->Read(data.data() + len, data.size() - len);
+					if (n == 0) break;
+					len += n;
+				}
+				data.resize(len);
+			}
+			catch (const std::exception& ex)
+			{
+				errors[i] = ex.what();
+				data.clear();
+			}
+		};
+
+#if defined(__linux__) && defined(IORING_SETUP_SUBMIT_ALL)
+		if (ring)
+		{
+			const auto direct = ring->mode == CacheMode::Direct;
+			std::vector<std::size_t> slotRequest(queueDepth);
+			std::vector<std::uint32_t> slotPending(queueDepth);
+			std::vector<std::uint32_t> freeSlots(queueDepth);
+			for (std::uint32_t i = 0; i < queueDepth; ++i) freeSlots[i] = queueDepth - 1 - i;
+			// direct reads land in these and are copied out
+			std::vector<AlignedBuffer> slotBuffers(direct ? queueDepth : 0);
+			std::vector<std::uint64_t> slotBufferSizes(slotBuffers.size());
+			// files on file systems refusing O_DIRECT and files read short are read again with blocking calls
+			std::vector<std::size_t> retries{};
+
+			std::size_t next = 0;
+			std::size_t inFlight = 0;
+			while (next < requests.size() || inFlight != 0)
+			{
+				unsigned prepared = 0;
+				for (; next < requests.size() && !freeSlots.empty(); ++next)
+				{
+					const auto slot = freeSlots.back();
+					freeSlots.pop_back();
+					if (direct)
+					{
+						const auto len = std::max<std::uint64_t>((requests[next].Size + DirectAlignment - 1) / DirectAlignment * DirectAlignment, DirectAlignment);
+						if (slotBufferSizes[slot] < len)
+						{
+							slotBuffers[slot] = MakeAlignedBuffer(len);
+							slotBufferSizes[slot] = len;
+						}
+						ring->Prepare(slot, requests[next], slotBuffers[slot].get(), len);
+					}
+					else
+					{
+						ring->Prepare(slot, requests[next], contents[next].data(), contents[next].size());
+					}
+					slotRequest[slot] = next;
+					slotPending[slot] = ring->ops;
+					++inFlight;
+					prepared += ring->ops;
+				}
+				ring->Submit(prepared, 1);
+				ring->Reap([&](const std::uint32_t slot, const Ring::Op op, const std::int32_t res)
+				{
+					const auto index = slotRequest[slot];
+					if (op == Ring::OpenOp && res == -EINVAL && direct)
+					{
+						retries.push_back(index);
+					}
+					else if (op == Ring::OpenOp && res < 0)
+					{
+						errors[index] = "open error: " + requests[index].Path.u8string() + ": " + strerror(-res);
+						contents[index].clear();
+					}
+					else if (op == Ring::ReadOp && res >= 0 && static_cast<std::uint64_t>(res) < requests[index].Size)
+					{
+						// network and FUSE file systems may return less than asked for, the blocking path reads on to the end
+						retries.push_back(index);
+					}
+					else if (op == Ring::ReadOp && res >= 0)
+					{
+						// a direct read may run past a file that grew since it was listed
+						contents[index].resize(std::min<std::size_t>(static_cast<std::size_t>(res), contents[index].size()));
+						if (direct) memcpy(contents[index].data(), slotBuffers[slot].get(), contents[index].size());
+					}
+					else if (op == Ring::ReadOp && res != -ECANCELED && errors[index].empty())
+					{
+						errors[index] = "read error: " + requests[index].Path.u8string() + ": " + strerror(-res);
+						contents[index].clear();
+					}
+					if (--slotPending[slot] == 0)
+					{
+						freeSlots.push_back(slot);
+						--inFlight;
+					}
+				});
+			}
+			for (const auto i : retries) readBlocking(i);
+			return;
+		}
+#endif
+
+		for (std::size_t i = 0; i < requests.size(); ++i) readBlocking(i);
+	}
+
+	ReadAhead::ReadAhead(Reader& reader, const std::uint64_t chunkSize) : reader(reader), chunkSize(chunkSize)
+	{
+		for (auto& buffer : buffers)
+		{
+			buffer = MakeAlignedBuffer(chunkSize);
+		}
+		thread = std::thread([this]() { Run(); });
+	}
+
+	ReadAhead::~ReadAhead()
+	{
+		{
+			std::lock_guard lock(mtx);
+			stop = true;
+		}
+		cv.notify_all();
+		thread.join();
+	}
+
+	std::string_view ReadAhead::Next()
+	{
+		std::unique_lock lock(mtx);
+		if (holding)
+		{
+			++released;
+			holding = false;
+			cv.notify_all();
+		}
+		cv.wait(lock, [&]() { return filled > released || done; });
+		if (filled == released)
+		{
+			if (error) std::rethrow_exception(error);
+			return {};
+		}
+		holding = true;
+		const auto slot = released % 2;
+		return { buffers[slot].get(), lengths[slot] };
+	}
+
+	void ReadAhead::Run()
+	{
+		while (true)
+		{
+			std::unique_lock lock(mtx);
+			cv.wait(lock, [&]() { return stop || filled - released < 2; });
+			if (stop) return;
+			const auto slot = filled % 2;
+			lock.unlock();
+
+			// fill the whole chunk so short reads do not shrink the hash input blocks
+			std::uint64_t len = 0;
+			std::exception_ptr readError{};
+			try
+			{
+				while (len < chunkSize)
+				{
+					const auto n = reader.Read(buffers[slot].get() + len, chunkSize - len);
+					if (n == 0) break;
+					len += n;
+				}
+			}
+			catch (...)
+			{
+				readError = std::current_exception();
+			}
+
+			lock.lock();
+			if (len != 0)
+			{
+				lengths[slot] = len;
+				++filled;
+			}
+			if (readError || len < chunkSize)
+			{
+				error = readError;
+				done = true;
+			}
+			lock.unlock();
+			cv.notify_all();
+			if (done) return;
+		}
+	}
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Macro.h"
+
+namespace File
+{
+	// flush the file contents to the storage device
+	void Sync(const std::filesystem::path& path);
+
+	// flush the entries of a directory, e.g. a rename into it
+	void SyncDirectory(const std::filesystem::path& path);
+
+	enum class EntryType { Unknown, Regular, Directory, Symlink, Other };
+
+	struct Status
+	{
+		EntryType Type = EntryType::Unknown;
+		std::uint64_t Size = 0;
+		// seconds since the unix epoch
+		std::int64_t ModifiedTime = 0;
+		std::uint64_t Device = 0;
+		std::uint64_t Inode = 0;
+		// hard links, always 1 on windows
+		std::uint64_t Links = 1;
+	};
+
+	// how reads go through the page cache: DropBehind evicts what was read (sequential and dontneed advice),
+	// Direct bypasses it with O_DIRECT and reads buffered from the first request that is not aligned
+	enum class CacheMode { Buffered, DropBehind, Direct };
+
+	// the alignment of buffers, offsets and lengths of direct reads
+	constexpr std::uint64_t DirectAlignment = 4096;
+
+	struct AlignedDelete
+	{
+		void operator()(char* p) const { operator delete[](p, std::align_val_t{ DirectAlignment }); }
+	};
+
+	using AlignedBuffer = std::unique_ptr<char[], AlignedDelete>;
+
+	inline AlignedBuffer MakeAlignedBuffer(const std::uint64_t size)
+	{
+		return AlignedBuffer(static_cast<char*>(operator new[](size, std::align_val_t{ DirectAlignment })));
+	}
+
+	// follows symlinks, Directory::GetStatus does not
+	std::optional<Status> GetStatus(const std::filesystem::path& path);
+
+	// an open directory, its entries are listed and opened relative to it instead of resolving the full path again
+	class Directory
+	{
+	public:
+		explicit Directory(std::filesystem::path path);
+		~Directory();
+
+		Directory(const Directory&) = delete;
+		Directory& operator=(const Directory&) = delete;
+
+		// calls func for every entry but . and .., type is Unknown when the file system does not report it
+		void List(const std::function<void(const std::string& name, EntryType type)>& func) const;
+
+		[[nodiscard]] std::optional<Status> GetStatus(const std::string& name) const;
+
+		[[nodiscard]] const std::filesystem::path& Path() const { return path; }
+
+		static std::uint64_t OpenCount() { return openCount; }
+
+	private:
+		friend class Reader;
+		friend class BatchReader;
+
+		std::filesystem::path path;
+#ifndef MacroWindows
+		int fd = -1;
+#endif
+		static inline std::atomic<std::uint64_t> openCount = 0;
+	};
+
+	class Reader
+	{
+	public:
+		explicit Reader(const std::filesystem::path& path, CacheMode mode = CacheMode::Buffered);
+		Reader(const Directory& dir, const std::string& name, CacheMode mode = CacheMode::Buffered);
+		~Reader();
+
+		Reader(const Reader&) = delete;
+		Reader& operator=(const Reader&) = delete;
+
+		// reads up to len bytes, returns 0 at the end of the file
+		std::uint64_t Read(char* buffer, std::uint64_t len);
+		// reads up to len bytes at offset without moving the position of Read
+		std::uint64_t ReadAt(char* buffer, std::uint64_t len, std::uint64_t offset);
+		// starts reading [offset, offset + len) into the cache in the background, nothing for direct reads
+		void Prefetch(std::uint64_t offset, std::uint64_t len);
+		// the [offset, offset + length) ranges below size holding data, in order, holes between them read as zeros,
+		// a single range over the whole file where the file system does not report holes
+		std::vector<std::pair<std::uint64_t, std::uint64_t>> DataRanges(std::uint64_t size);
+		// where the first extent lies on the device, only good for ordering reads: bytes on linux, clusters on windows
+		std::optional<std::uint64_t> FirstExtent();
+
+	private:
+		// leaves direct reads before a request they cannot serve, drops what was read behind
+		void BeforeRead(const char* buffer, std::uint64_t len, std::uint64_t offset);
+		void AfterRead(std::uint64_t offset, std::uint64_t len);
+
+		std::filesystem::path path;
+		CacheMode mode;
+		// the offset of the next Read
+		std::uint64_t position = 0;
+#ifdef MacroWindows
+		void* file = nullptr;
+#else
+		int fd = -1;
+#endif
+	};
+
+	// reads whole files with up to queueDepth opens, reads and closes in flight through io_uring,
+	// one file after another with blocking calls where io_uring is unavailable or queueDepth is 0
+	class BatchReader
+	{
+	public:
+		static constexpr std::uint32_t MaxQueueDepth = 4096;
+
+		struct Request
+		{
+			// opened relative to Dir by Name when set, by Path otherwise
+			const Directory* Dir = nullptr;
+			std::string Name;
+			std::filesystem::path Path;
+			std::uint64_t Size = 0;
+		};
+
+		explicit BatchReader(std::uint32_t queueDepth, CacheMode mode = CacheMode::Buffered);
+		~BatchReader();
+
+		BatchReader(const BatchReader&) = delete;
+		BatchReader& operator=(const BatchReader&) = delete;
+
+		[[nodiscard]] bool Async() const { return ring != nullptr; }
+
+		// contents[i] receives up to Size bytes of requests[i], errors[i] stays empty unless it failed
+		void Read(const std::vector<Request>& requests, std::vector<std::string>& contents, std::vector<std::string>& errors);
+
+	private:
+		struct Ring;
+
+		std::uint32_t queueDepth;
+		CacheMode mode;
+		std::unique_ptr<Ring> ring;
+	};
+
+	// reads the next chunk of a file on its own thread while the caller processes the current one
+	class ReadAhead
+	{
+	public:
+		static constexpr std::uint64_t DefaultChunkSize = 4 * 1024 * 1024;
+		explicit ReadAhead(Reader& reader, std::uint64_t chunkSize = DefaultChunkSize);
+		~ReadAhead();
+
+		ReadAhead(const ReadAhead&) = delete;
+		ReadAhead& operator=(const ReadAhead&) = delete;
+
+		// the next chunk, valid until the following call and empty at the end of the file, read errors are rethrown here
+		std::string_view Next();
+
+	private:
+		void Run();
+
+		Reader& reader;
+		std::uint64_t chunkSize;
+		AlignedBuffer buffers[2];
+		std::uint64_t lengths[2]{};
+		// chunks filled by the reading thread and released by the caller, they are never more than two apart
+		std::uint64_t filled = 0;
+		std::uint64_t released = 0;
+		bool holding = false;
+		bool done = false;
+		bool stop = false;
+		std::exception_ptr error{};
+		std::mutex mtx{};
+		std::condition_variable cv{};
+		std::thread thread{};
+	};
+
+	class MemoryMap
+	{
+	public:
+		explicit MemoryMap(const std::filesystem::path& path);
+		~MemoryMap();
+
+		MemoryMap(const MemoryMap&) = delete;
+		MemoryMap& operator=(const MemoryMap&) = delete;
+
+		[[nodiscard]] const char* Data() const { return data; }
+		[[nodiscard]] std::uint64_t Size() const { return size; }
+
+	private:
+		const char* data = nullptr;
+		std::uint64_t size = 0;
+#ifdef MacroWindows
+		void* file = nullptr;
+		void* mapping = nullptr;
+#endif
+	};
+}
@@ -1,19 +1,27 @@
 #include "FileMd5Database.h"
 
-#include <deque>
+#include <atomic>
 #include <regex>
 #include <sstream>
 #include <execution>
+#include <charconv>
 #include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <shared_mutex>
+#include <mutex>
 
+#include "ColumnScan.h"
 #include "Convert.h"
 #include "CSV.h"
 #include "Cryptography.h"
+#include "File.h"
+#include "PathMatcher.h"
 #include "String.h"
 #include "Time.h"
 #include "Macro.h"
 
-#define LogInfo(path,md5,size,time) Log.Write("<",ToString(path),",<" ,md5, "," ,Convert::ToString(size), ",", time ,">>")
+#define LogInfo(path,md5,size,time) Log.Write("<",ToString(path),",<" ,Md5ToString(md5), "," ,Convert::ToString(size), ",", TimestampToString(time) ,">>")
 #define LogErr(path, message) Log.Write<LogLevel::Error>("[Error] [",ToString(path),"] [", MacroFunctionName,"] [" __FILE__ ":" MacroLine "] ", message)
 
 ArgumentOptionCpp(LogLevel, Kill, None, Error, Info, Debug)
@@ -21,6 +29,12 @@ ArgumentOptionCpp(MatchMethod, Contain, StartWith, EndWith, Regex, Eq, Gt, Lt)
 ArgumentOptionCpp(Data, Path, Md5, Size, Time)
 ArgumentOptionCpp(ExportFormat, CSV, JSON)
 ArgumentOptionCpp(AlterType, DeviceName, DriveLetter)
+ArgumentOptionCpp(StorageLayout, Row, Columnar, Block)
+ArgumentOptionCpp(IoEngine, Blocking, Uring)
+ArgumentOptionCpp(BuildMode, Full, Dedup)
+ArgumentOptionCpp(ReadOrder, Listing, Inode, Extent)
+ArgumentOptionCpp(IoMode, Buffered, Fadvise, Direct)
+ArgumentOptionCpp(HashAlgorithm, Md5, Sha256, Blake3, Xxh64)
 
 inline std::string ToString(const std::filesystem::path& path)
 {
@@ -76,40 +90,325 @@ static void LogWorker()
 	}
 }
 
-inline std::string FileLastModified(const std::filesystem::path& file)
+static Cryptography::Hasher::Algorithm FileMd5DatabaseHasherAlgorithm(const HashAlgorithm algorithm)
 {
-	try
+	static const std::unordered_map<HashAlgorithm, Cryptography::Hasher::Algorithm> algorithms
 	{
-		const auto time = std::chrono::system_clock::to_time_t(std::chrono::time_point_cast<std::chrono::system_clock::duration>(
-			last_write_time(file)
-			- decltype(std::filesystem::last_write_time({}))::clock::now()
-			+ std::chrono::system_clock::now()));
-		if (static_cast<int64_t>(time) < 0)
-		{
-			throw std::runtime_error("negative time value " + Convert::ToString(static_cast<int64_t>(time)));
-		}
-		tm local{};
-		Time::Local(&local, &time);
-		std::ostringstream ss{};
-		ss << std::put_time(&local, "%F %T");
-		return ss.str();
+		{ HashAlgorithm::Md5, Cryptography::Hasher::Algorithm::Md5 },
+		{ HashAlgorithm::Sha256, Cryptography::Hasher::Algorithm::Sha256 },
+		{ HashAlgorithm::Blake3, Cryptography::Hasher::Algorithm::Blake3 },
+		{ HashAlgorithm::Xxh64, Cryptography::Hasher::Algorithm::Xxh64 }
+	};
+	return algorithms.at(algorithm);
+}
+
+// the bytes of the digests that do not fit in place, in chunks that are never freed, each thread fills a chunk of its own
+static const uint8_t* Md5DigestPool(const uint8_t* data, const uint64_t len)
+{
+	static constexpr uint64_t ChunkLen = 64 * 1024;
+	static std::mutex mtx{};
+	static std::vector<std::unique_ptr<uint8_t[]>> chunks{};
+	thread_local uint8_t* chunk = nullptr;
+	thread_local uint64_t left = 0;
+	if (left < Md5Digest::Len)
+	{
+		std::lock_guard lock(mtx);
+		chunks.push_back(std::make_unique<uint8_t[]>(ChunkLen));
+		chunk = chunks.back().get();
+		left = ChunkLen;
 	}
-	catch (const std::exception& ex)
+	auto* p = chunk + (ChunkLen - left);
+	memcpy(p, data, len);
+	left -= Md5Digest::Len;
+	return p;
+}
+
+Md5Digest::Md5Digest(const uint8_t* data, const uint64_t len)
+{
+	const auto n = std::min(len, Len);
+	if (Len <= InlineLen)
+	{
+		memcpy(this->data.Word, data, n);
+		return;
+	}
+	// a nil digest stays all zero in place
+	if (std::all_of(data, data + n, [](const uint8_t b) { return b == 0; })) return;
+	this->data.Wide = Md5DigestPool(data, n);
+}
+
+Md5Digest Md5Digest::View(const uint8_t* data)
+{
+	if (Len <= InlineLen) return { data, Len };
+	Md5Digest digest{};
+	if (!std::all_of(data, data + Len, [](const uint8_t b) { return b == 0; })) digest.data.Wide = data;
+	return digest;
+}
+
+Md5Digest Md5Digest::Owned() const
+{
+	return Len <= InlineLen || Nil() ? *this : Md5Digest(data.Wide, Len);
+}
+
+const uint8_t* Md5Digest::Data() const
+{
+	static constexpr uint8_t zeros[Cryptography::Digest::MaxLen]{};
+	if (Len <= InlineLen) return data.Word;
+	return Nil() ? zeros : data.Wide;
+}
+
+std::string Md5ToString(const Md5Digest& md5)
+{
+	return IsNilMd5(md5) ? std::string() : Cryptography::Digest::Hex(Cryptography::Digest(md5.Data(), Md5Digest::Len));
+}
+
+Md5Digest Md5FromString(const std::string& md5)
+{
+	Cryptography::Digest digest{};
+	if (!md5.empty() && (!Cryptography::Digest::FromHex(md5, digest) || digest.Len > Md5Digest::Len)) throw std::runtime_error("invalid md5: " + md5);
+	return { digest.Word, digest.Len };
+}
+
+uint8_t DigestLen(const HashAlgorithm algorithm)
+{
+	return static_cast<uint8_t>(Cryptography::Hasher::DigestLen(FileMd5DatabaseHasherAlgorithm(algorithm)));
+}
+
+std::string TimestampToString(const Timestamp& time)
+{
+	if (IsNilTime(time)) return "";
+	const auto t = static_cast<time_t>(time.Value);
+	tm local{};
+	Time::Local(&local, &t);
+	char buf[64]{};
+	return std::string(buf, std::strftime(buf, sizeof buf, "%F %T", &local));
+}
+
+std::optional<Timestamp> ParseLocalTime(const std::string_view time)
+{
+	const auto field = [&](const std::size_t pos, const std::size_t len, int& out)
+	{
+		if (time.length() < pos + len) return false;
+		const auto [p, e] = std::from_chars(time.data() + pos, time.data() + pos + len, out);
+		return e == std::errc{} && p == time.data() + pos + len;
+	};
+	tm local{};
+	if (!(time.length() == 10 || time.length() == 19)
+		|| !field(0, 4, local.tm_year) || time[4] != '-'
+		|| !field(5, 2, local.tm_mon) || time[7] != '-'
+		|| !field(8, 2, local.tm_mday)) return std::nullopt;
+	if (time.length() == 19 && (time[10] != ' '
+		|| !field(11, 2, local.tm_hour) || time[13] != ':'
+		|| !field(14, 2, local.tm_min) || time[16] != ':'
+		|| !field(17, 2, local.tm_sec))) return std::nullopt;
+	local.tm_year -= 1900;
+	local.tm_mon -= 1;
+	local.tm_isdst = -1;
+	const auto t = mktime(&local);
+	if (t == static_cast<time_t>(-1)) return std::nullopt;
+	return Timestamp{ static_cast<int64_t>(t) };
+}
+
+Timestamp TimestampFromString(const std::string& time)
+{
+	if (time.empty()) return {};
+	if (time[0] == '@') return Timestamp{ Convert::FromString<int64_t>(time.substr(1)) };
+	if (time[0] == '-' && time.length() > 2)
+	{
+		static const std::unordered_map<char, int64_t> units{ {'s', 1}, {'m', 60}, {'h', 3600}, {'d', 86400}, {'w', 604800} };
+		const auto unit = units.find(time.back());
+		if (unit == units.end()) throw std::runtime_error("invalid time unit: " + time);
+		const auto now = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		return Timestamp{ now - Convert::FromString<int64_t>(time.substr(1, time.length() - 2)) * unit->second };
+	}
+	if (const auto local = ParseLocalTime(time)) return *local;
+	throw std::runtime_error("invalid time: " + time);
+}
+
+uint64_t ByteSizeFromString(const std::string& size)
+{
+	static const std::unordered_map<char, uint64_t> units{ {'K', 1ull << 10}, {'M', 1ull << 20}, {'G', 1ull << 30}, {'T', 1ull << 40} };
+	if (size.empty()) throw std::runtime_error("invalid size: " + size);
+	const auto unit = units.find(static_cast<char>(toupper(static_cast<unsigned char>(size.back()))));
+	if (unit == units.end()) return Convert::FromString<uint64_t>(size);
+	return Convert::FromString<uint64_t>(size.substr(0, size.length() - 1)) * unit->second;
+}
+
+Database::iterator Database::find(const std::string_view path)
+{
+	const auto pos = static_cast<const Database*>(this)->find(path);
+	return records.begin() + (pos - records.cbegin());
+}
+
+Database::const_iterator Database::find(const std::string_view path) const
+{
+	if (index.empty())
 	{
-		LogErr(file, ex.what());
-		return "";
+		const auto pos = std::lower_bound(records.begin(), records.end(), path, [](const Record& record, const std::string_view p) { return record.first < p; });
+		return pos != records.end() && pos->first == path ? pos : records.end();
 	}
+	const auto i = index[Probe(path)];
+	return i == 0 ? records.end() : records.begin() + (i - 1);
 }
 
-ModelRef::ModelRef(const std::string_view& path, const std::string_view& md5, const uint64_t size, const std::string_view& time) :Path(path), Md5(md5), Size(size), Time(time) {};
+std::pair<Database::iterator, bool> Database::emplace(const std::string_view path, const V& v)
+{
+	if (records.size() >= std::numeric_limits<uint32_t>::max()) throw std::runtime_error("database full");
+	const auto append = records.empty() || records.back().first < path;
+	std::size_t slot = 0;
+	if (index.empty() && !append)
+	{
+		if (const auto pos = find(path); pos != records.end()) return { pos, false };
+		Index();
+	}
+	if (!index.empty())
+	{
+		if ((records.size() + 1) * 2 > index.size()) Rehash(index.size() * 2);
+		slot = Probe(path);
+		if (index[slot] != 0) return { records.begin() + (index[slot] - 1), false };
+	}
+
+	auto* p = static_cast<char*>(arena->allocate(path.size(), 1));
+	std::copy(path.begin(), path.end(), p);
+	sorted = sorted && append;
+	records.emplace_back(std::string_view(p, path.size()), v);
+	if (!index.empty()) index[slot] = static_cast<uint32_t>(records.size());
+	return { records.end() - 1, true };
+}
+
+void Database::merge(const Database& other)
+{
+	reserve(records.size() + other.size());
+	for (const auto& [path, v] : other) emplace(path, v);
+}
+
+void Database::reserve(const std::size_t count)
+{
+	records.reserve(count);
+	if (index.empty()) return;
+	auto slots = index.size();
+	while (count * 2 > slots) slots *= 2;
+	if (slots != index.size()) Rehash(slots);
+}
+
+void Database::Index()
+{
+	if (!index.empty()) return;
+	std::size_t slots = 16;
+	while ((records.capacity() + 1) * 2 > slots) slots *= 2;
+	Rehash(slots);
+}
+
+std::vector<const Database::Record*> Database::Ordered() const
+{
+	std::vector<const Record*> order(records.size());
+	std::transform(records.begin(), records.end(), order.begin(), [](const Record& record) { return &record; });
+	if (!sorted) std::sort(std::execution::par_unseq, order.begin(), order.end(), [](const Record* a, const Record* b) { return a->first < b->first; });
+	return order;
+}
+
+std::size_t Database::Probe(const std::string_view path) const
+{
+	const auto mask = index.size() - 1;
+	for (auto slot = std::hash<std::string_view>()(path) & mask;; slot = (slot + 1) & mask)
+	{
+		const auto i = index[slot];
+		if (i == 0 || records[i - 1].first == path) return slot;
+	}
+}
+
+void Database::Rehash(const std::size_t slots)
+{
+	index.assign(slots, 0);
+	for (std::size_t i = 0; i < records.size(); ++i) index[Probe(records[i].first)] = static_cast<uint32_t>(i + 1);
+}
+
+void PathTree::AppendPath(std::string& out, const uint32_t dir) const
+{
+	// every chain of parents ends in directory 0, the empty path, names are copied back to front
+	auto end = out.length();
+	for (auto d = dir; d != 0; d = Parents[d]) end += Name(d).length();
+	out.resize(end);
+	for (auto d = dir; d != 0; d = Parents[d])
+	{
+		const auto name = Name(d);
+		end -= name.length();
+		std::copy(name.begin(), name.end(), out.begin() + static_cast<std::ptrdiff_t>(end));
+	}
+}
+
+std::string PathTree::Path(const uint32_t dir) const
+{
+	std::string path{};
+	AppendPath(path, dir);
+	return path;
+}
+
+std::pair<uint32_t, uint32_t> PathTree::PrefixRange(const std::string_view prefix) const
+{
+	// paths starting with prefix follow every path below it and precede every other path above it
+	std::string path{};
+	const auto partition = [&](const auto& pred)
+	{
+		uint64_t lo = 0;
+		uint64_t hi = Count;
+		while (lo < hi)
+		{
+			const auto mid = lo + (hi - lo) / 2;
+			path.clear();
+			AppendPath(path, static_cast<uint32_t>(mid));
+			if (pred(std::string_view(path))) lo = mid + 1;
+			else hi = mid;
+		}
+		return static_cast<uint32_t>(lo);
+	};
+	const auto first = partition([&](const std::string_view p) { return p < prefix; });
+	const auto last = partition([&](const std::string_view p) { return p < prefix || p.substr(0, prefix.length()) == prefix; });
+	return { first, last };
+}
+
+std::optional<uint32_t> PathTree::Find(const std::string_view path) const
+{
+	const auto [first, last] = PrefixRange(path);
+	if (first == last || Path(first) != path) return std::nullopt;
+	return first;
+}
+
+ModelRef::ModelRef(const std::string_view& path, const Md5Digest& md5, const uint64_t size, const Timestamp& time, const uint32_t flags) :
+	Tree(nullptr), Dir(0), Name(path), Md5(md5), Size(size), Time(time), Flags(flags) {}
+
+ModelRef::ModelRef(const PathTree* tree, const uint32_t dir, const std::string_view& name, const Md5Digest& md5, const uint64_t size, const Timestamp& time, const uint32_t flags) :
+	Tree(tree), Dir(dir), Name(name), Md5(md5), Size(size), Time(time), Flags(flags) {}
+
+ModelRef::ModelRef() : ModelRef(std::string_view{}, {}, 0, {}, 0) {}
+
+std::string ModelRef::Path() const
+{
+	std::string path{};
+	AppendPath(path);
+	return path;
+}
+
+void ModelRef::AppendPath(std::string& out) const
+{
+	if (Tree) Tree->AppendPath(out, Dir);
+	out.append(Name);
+}
 
-ModelRef::ModelRef()
+std::string RecordFlagsToString(const uint32_t flags)
 {
-	static const auto* nilStr = "";
-	Path = nilStr;
-	Md5 = nilStr;
-	Size = 0;
-	Time = nilStr;
+	static const std::vector<std::pair<uint32_t, std::string>> names
+	{
+		{ RecordFlag::Hardlink, "hardlink" },
+		{ RecordFlag::Partial, "partial" }
+	};
+	std::string res{};
+	for (const auto& [flag, name] : names)
+	{
+		if (!(flags & flag)) continue;
+		if (!res.empty()) res += ",";
+		res += name;
+	}
+	return res;
 }
 
 void FileMd5DatabaseInit(const LogLevel& level, const std::filesystem::path& file, bool console)
@@ -126,58 +425,380 @@ void FileMd5DatabaseEnd()
 	Log.LogThread.join();
 }
 
-void FileMd5DatabaseAdd(const std::string& deviceName, const std::filesystem::path& file, Database& fmd)
+struct FileEntry
+{
+	std::filesystem::path File;
+	// the listed parent directory, the file is opened relative to it when it is still open
+	std::shared_ptr<const ::File::Directory> Dir;
+	std::string Name;
+	K Path;
+	uintmax_t Size;
+	Timestamp Time;
+	uint64_t Device;
+	uint64_t Inode;
+	uint64_t Links;
+};
+
+static constexpr uint64_t ReadBufferSize = 64 * 1024;
+
+static FileEntry FileMd5DatabaseEntry(const std::string& deviceName, const std::filesystem::path& file, std::shared_ptr<const ::File::Directory> dir, std::string name,
+	const std::optional<::File::Status>& status)
+{
+	FileEntry entry{ file, std::move(dir), std::move(name), deviceName, 0, {}, 0, 0, 1 };
+	if (Log.Level >= LogLevel::Debug) Log.Write<LogLevel::Debug>("-> ", ToString(entry.File));
+	String::StringCombine(entry.Path, ":", file.u8string());
+	if (Log.Level >= LogLevel::Debug) Log.Write<LogLevel::Debug>("-> ", ToString(std::filesystem::u8path(entry.Path)));
+	if (status)
+	{
+		entry.Size = status->Size;
+		entry.Time = Timestamp{ status->ModifiedTime };
+		entry.Device = status->Device;
+		entry.Inode = status->Inode;
+		entry.Links = status->Links;
+	}
+	else
+	{
+		LogErr(file, "stat error");
+	}
+	if (Log.Level >= LogLevel::Debug) Log.Write<LogLevel::Debug>("-> ", Convert::ToString(entry.Size));
+	if (Log.Level >= LogLevel::Debug) Log.Write<LogLevel::Debug>("-> ", TimestampToString(entry.Time));
+	return entry;
+}
+
+static FileEntry FileMd5DatabaseStat(const std::string& deviceName, const std::filesystem::path& file)
+{
+	return FileMd5DatabaseEntry(deviceName, file, nullptr, {}, ::File::GetStatus(file));
+}
+
+// how the reads of one build go, from BuilderOptions
+struct ReadPolicy
+{
+	explicit ReadPolicy(const BuilderOptions& options) :
+		Devices(options.MaxDeviceReads),
+		Bandwidth(options.MaxReadBps),
+		Cache(Modes().at(options.ReadMode)) {}
+
+	static const std::unordered_map<IoMode, ::File::CacheMode>& Modes()
+	{
+		static const std::unordered_map<IoMode, ::File::CacheMode> modes
+		{
+			{ IoMode::Buffered, ::File::CacheMode::Buffered },
+			{ IoMode::Fadvise, ::File::CacheMode::DropBehind },
+			{ IoMode::Direct, ::File::CacheMode::Direct }
+		};
+		return modes;
+	}
+
+	Thread::KeyedLimit<uint64_t> Devices;
+	Thread::TokenBucket Bandwidth;
+	::File::CacheMode Cache;
+};
+
+static std::unique_ptr<::File::Reader> FileMd5DatabaseOpen(const FileEntry& entry, const ::File::CacheMode mode = ::File::CacheMode::Buffered)
+{
+	return entry.Dir ? std::make_unique<::File::Reader>(*entry.Dir, entry.Name, mode) : std::make_unique<::File::Reader>(entry.File, mode);
+}
+
+static Cryptography::Hasher FileMd5DatabaseHasher(const HashAlgorithm algorithm)
+{
+	return Cryptography::Hasher(FileMd5DatabaseHasherAlgorithm(algorithm));
+}
+
+static Md5Digest FileMd5DatabaseDigest(Cryptography::Hasher& hasher)
+{
+	const auto digest = hasher.Digest(Md5Digest::Len);
+	return { digest.Word, digest.Len };
+}
+
+// reads only the data ranges of a sparse file, the holes between them are hashed as zeros
+static void FileMd5DatabaseHashSparse(::File::Reader& reader, Cryptography::Hasher& hasher, const std::vector<std::pair<uint64_t, uint64_t>>& ranges, const uint64_t size,
+	ReadPolicy* reads)
+{
+	const auto buffer = ::File::MakeAlignedBuffer(::File::ReadAhead::DefaultChunkSize);
+	uint64_t pos = 0;
+	for (const auto& [offset, length] : ranges)
+	{
+		hasher.AppendZeros(offset - pos);
+		for (pos = offset; pos < offset + length;)
+		{
+			// the chunk after this one is on its way while this one is hashed, holes are skipped by the file system
+			reader.Prefetch(pos + ::File::ReadAhead::DefaultChunkSize, ::File::ReadAhead::DefaultChunkSize);
+			const auto n = reader.ReadAt(buffer.get(), std::min(::File::ReadAhead::DefaultChunkSize, offset + length - pos), pos);
+			if (n == 0) throw std::runtime_error("file truncated while reading");
+			if (reads) reads->Bandwidth.Acquire(n);
+			hasher.Append(reinterpret_cast<const uint8_t*>(buffer.get()), n);
+			pos += n;
+		}
+	}
+	hasher.AppendZeros(size - pos);
+}
+
+static Md5Digest FileMd5DatabaseHash(const FileEntry& entry, const HashAlgorithm algorithm, ReadPolicy* reads = nullptr)
 {
+	if (entry.Size == 0) return {};
 	try
 	{
-		const auto fixPath =
-#ifdef MacroWindows
-			std::filesystem::u8path(R"(\\?\)" + file.u8string());
-#else
-			file;
-#endif
-		if (Log.Level >= LogLevel::Debug) Log.Write<LogLevel::Debug>("-> ", ToString(fixPath));
-		auto fullPath = deviceName;
-		String::StringCombine(fullPath, ":", file.u8string());
-		if (Log.Level >= LogLevel::Debug) Log.Write<LogLevel::Debug>("-> ", ToString(std::filesystem::u8path(fullPath)));
-		std::string md5;
-		uintmax_t size;
-		try
+		const auto hold = reads ? reads->Devices.Acquire(entry.Device) : Thread::KeyedLimit<uint64_t>::Hold{};
+		const auto reader = FileMd5DatabaseOpen(entry, reads ? reads->Cache : ::File::CacheMode::Buffered);
+		auto hasher = FileMd5DatabaseHasher(algorithm);
+		if (entry.Size > ReadBufferSize)
+		{
+			if (const auto ranges = reader->DataRanges(entry.Size); ranges.size() != 1 || ranges.front() != std::pair<uint64_t, uint64_t>{ 0, entry.Size })
+			{
+				if (Log.Level >= LogLevel::Debug) Log.Write<LogLevel::Debug>("-> sparse ", Convert::ToString(ranges.size()));
+				FileMd5DatabaseHashSparse(*reader, hasher, ranges, entry.Size, reads);
+				return FileMd5DatabaseDigest(hasher);
+			}
+		}
+		if (entry.Size > ::File::ReadAhead::DefaultChunkSize)
+		{
+			// the next chunk is read while this one is hashed
+			::File::ReadAhead readAhead(*reader);
+			for (auto chunk = readAhead.Next(); !chunk.empty(); chunk = readAhead.Next())
+			{
+				if (reads) reads->Bandwidth.Acquire(chunk.size());
+				hasher.Append(reinterpret_cast<const uint8_t*>(chunk.data()), chunk.size());
+			}
+			return FileMd5DatabaseDigest(hasher);
+		}
+		// smaller files are requested whole up front and hashed as their first buffers arrive
+		if (entry.Size > ReadBufferSize) reader->Prefetch(0, entry.Size);
+		const auto buffer = ::File::MakeAlignedBuffer(ReadBufferSize);
+		while (const auto n = reader->Read(buffer.get(), ReadBufferSize))
+		{
+			if (reads) reads->Bandwidth.Acquire(n);
+			hasher.Append(reinterpret_cast<const uint8_t*>(buffer.get()), n);
+		}
+		return FileMd5DatabaseDigest(hasher);
+	}
+	catch (const std::exception& ex)
+	{
+		LogErr(entry.File, ex.what());
+		return {};
+	}
+}
+
+// dedup builds hash this many bytes from each end of a file before deciding to read all of it
+static constexpr uint64_t PartialHashSize = 64 * 1024;
+
+static Md5Digest FileMd5DatabasePartialHash(const FileEntry& entry, const HashAlgorithm algorithm, ReadPolicy& reads)
+{
+	try
+	{
+		const auto hold = reads.Devices.Acquire(entry.Device);
+		const auto reader = FileMd5DatabaseOpen(entry, reads.Cache);
+		const auto buffer = ::File::MakeAlignedBuffer(PartialHashSize);
+		auto hasher = FileMd5DatabaseHasher(algorithm);
+		for (const auto start : { uint64_t{ 0 }, entry.Size - PartialHashSize })
+		{
+			for (uint64_t pos = 0; pos < PartialHashSize;)
+			{
+				const auto n = reader->ReadAt(buffer.get() + pos, PartialHashSize - pos, start + pos);
+				if (n == 0) throw std::runtime_error("file truncated while reading");
+				pos += n;
+			}
+			reads.Bandwidth.Acquire(PartialHashSize);
+			hasher.Append(reinterpret_cast<const uint8_t*>(buffer.get()), PartialHashSize);
+		}
+		return FileMd5DatabaseDigest(hasher);
+	}
+	catch (const std::exception& ex)
+	{
+		LogErr(entry.File, ex.what());
+		return {};
+	}
+}
+
+static std::pair<K, V> FileMd5DatabaseFinish(FileEntry& entry, const Md5Digest& md5, const uint32_t flags = 0)
+{
+	if (Log.Level >= LogLevel::Debug) Log.Write<LogLevel::Debug>("-> ", Md5ToString(md5));
+	LogInfo(entry.File, md5, entry.Size, entry.Time);
+	return { std::move(entry.Path), V(md5, entry.Size, entry.Time, (entry.Links > 1 ? RecordFlag::Hardlink : 0) | flags) };
+}
+
+// the previous record of an entry whose size and time did not change, its digest may be nil or partial
+static std::optional<V> FileMd5DatabasePrevious(const FileEntry& entry, const Database& fmd, std::shared_mutex& fmdMtx)
+{
+	std::shared_lock lock(fmdMtx);
+	const auto pos = fmd.find(entry.Path);
+	if (pos == fmd.end()) return std::nullopt;
+	const auto& [md5, size, time, flags] = pos->second;
+	if (size != entry.Size || time != entry.Time || IsNilTime(entry.Time)) return std::nullopt;
+	return pos->second;
+}
+
+static std::optional<Md5Digest> FileMd5DatabaseFull(const std::optional<V>& previous)
+{
+	if (!previous) return std::nullopt;
+	const auto& [md5, size, time, flags] = *previous;
+	if ((IsNilMd5(md5) && size != 0) || (flags & RecordFlag::Partial)) return std::nullopt;
+	if (Log.Level >= LogLevel::Debug) Log.Write<LogLevel::Debug>("-> unchanged");
+	return md5;
+}
+
+static std::optional<Md5Digest> FileMd5DatabaseUnchanged(const FileEntry& entry, const Database& fmd, std::shared_mutex& fmdMtx)
+{
+	return FileMd5DatabaseFull(FileMd5DatabasePrevious(entry, fmd, fmdMtx));
+}
+
+static std::pair<K, V> FileMd5DatabaseRecord(const std::string& deviceName, const std::filesystem::path& file, const HashAlgorithm algorithm)
+{
+	auto entry = FileMd5DatabaseStat(deviceName, file);
+	const auto md5 = FileMd5DatabaseHash(entry, algorithm);
+	return FileMd5DatabaseFinish(entry, md5);
+}
+
+class SmallFileBatch
+{
+public:
+	static constexpr uintmax_t MaxFileSize = 64 * 1024;
+
+	SmallFileBatch(Thread::BoundedChannel<std::pair<K, V>>& records, const BuilderOptions& options, ReadPolicy& reads) :
+		records(records),
+		reads(reads),
+		algorithm(options.Algorithm),
+		lanes(algorithm == HashAlgorithm::Md5 ? Cryptography::Md5MultiBuffer::Lanes() : 1),
+		reader(options.Engine == IoEngine::Uring ? options.QueueDepth : 0, reads.Cache),
+		capacity(std::max<uint64_t>(lanes * 8, reader.Async() ? options.QueueDepth : 0)) {}
+
+	SmallFileBatch(const SmallFileBatch&) = delete;
+	SmallFileBatch& operator=(const SmallFileBatch&) = delete;
+
+	~SmallFileBatch()
+	{
+		Flush();
+	}
+
+	[[nodiscard]] bool Accept(const FileEntry& entry) const
+	{
+		return (lanes > 1 || reader.Async()) && entry.Size != 0 && entry.Size <= MaxFileSize;
+	}
+
+	void Add(FileEntry entry)
+	{
+		requests.push_back({ entry.Dir.get(), entry.Name, entry.File, entry.Size });
+		entries.push_back(std::move(entry));
+		if (entries.size() >= capacity) Flush();
+	}
+
+	void Flush()
+	{
+		if (entries.empty()) return;
 		{
-			size = file_size(fixPath);
+			std::vector<uint64_t> devices{};
+			uint64_t bytes = 0;
+			for (const auto& entry : entries)
+			{
+				devices.push_back(entry.Device);
+				bytes += entry.Size;
+			}
+			std::sort(devices.begin(), devices.end());
+			devices.erase(std::unique(devices.begin(), devices.end()), devices.end());
+			std::vector<Thread::KeyedLimit<uint64_t>::Hold> holds{};
+			for (const auto device : devices) holds.push_back(reads.Devices.Acquire(device));
+			reads.Bandwidth.Acquire(bytes);
+			reader.Read(requests, contents, errors);
 		}
-		catch (const std::exception& e)
+		std::vector<std::string_view> messages{};
+		for (std::size_t i = 0; i < entries.size(); ++i)
 		{
-			LogErr(file, e.what());
-			size = 0;
+			if (errors[i].empty()) messages.emplace_back(contents[i]);
 		}
-		if (Log.Level >= LogLevel::Debug) Log.Write<LogLevel::Debug>("-> ", Convert::ToString(size));
-		if (size == 0)
+		std::vector<Md5Digest> digests{};
+		if (algorithm == HashAlgorithm::Md5)
 		{
-			md5 = "";
+			std::vector<Cryptography::Md5::DigestData> md5s{};
+			Cryptography::Md5MultiBuffer::Hash(messages, md5s);
+			for (const auto& md5 : md5s) digests.emplace_back(md5.Word, sizeof md5.Word);
 		}
 		else
 		{
-			try
+			for (const auto& message : messages)
 			{
-				std::ifstream fs(fixPath, std::ios::in | std::ios::binary);
-				const auto buffer = std::make_unique<char[]>(4096);
-				fs.rdbuf()->pubsetbuf(buffer.get(), 4096);
-				
-				Cryptography::Md5 md5Gen{};
-				md5Gen.Append(fs);
-				md5 = md5Gen.HexDigest();
+				auto hasher = FileMd5DatabaseHasher(algorithm);
+				hasher.Append(reinterpret_cast<const uint8_t*>(message.data()), message.size());
+				digests.push_back(FileMd5DatabaseDigest(hasher));
 			}
-			catch (const std::exception& ex)
+		}
+		for (std::size_t i = 0, d = 0; i < entries.size(); ++i)
+		{
+			if (!errors[i].empty())
 			{
-				LogErr(file, ex.what());
+				LogErr(entries[i].File, errors[i]);
+				records.Write(FileMd5DatabaseFinish(entries[i], {}));
+				continue;
 			}
+			records.Write(FileMd5DatabaseFinish(entries[i], digests[d++]));
+		}
+		entries.clear();
+		requests.clear();
+	}
+
+private:
+	Thread::BoundedChannel<std::pair<K, V>>& records;
+	ReadPolicy& reads;
+	HashAlgorithm algorithm;
+	std::uint64_t lanes;
+	::File::BatchReader reader;
+	std::uint64_t capacity;
+	std::vector<FileEntry> entries{};
+	std::vector<::File::BatchReader::Request> requests{};
+	std::vector<std::string> contents{};
+	std::vector<std::string> errors{};
+};
+
+// digests of multiply linked files by (device, inode, size, mtime), further links wait for the first one instead of reading it again
+class InodeCache
+{
+public:
+	// returns the digest of another link, or nullopt if the caller is the first link and has to fulfil owner
+	std::optional<Md5Digest> Lookup(const FileEntry& entry, std::promise<Md5Digest>& owner)
+	{
+		std::unique_lock lock(mtx);
+		const auto [pos, inserted] = digests.try_emplace(Key{ entry.Device, entry.Inode, entry.Size, entry.Time.Value });
+		if (inserted)
+		{
+			pos->second = owner.get_future().share();
+			return std::nullopt;
+		}
+		const auto digest = pos->second;
+		lock.unlock();
+		if (Log.Level >= LogLevel::Debug) Log.Write<LogLevel::Debug>("-> hardlink");
+		return digest.get();
+	}
+
+private:
+	struct Key
+	{
+		uint64_t Device;
+		uint64_t Inode;
+		uint64_t Size;
+		int64_t Time;
+
+		bool operator==(const Key& other) const
+		{
+			return Device == other.Device && Inode == other.Inode && Size == other.Size && Time == other.Time;
 		}
-		if (Log.Level >= LogLevel::Debug) Log.Write<LogLevel::Debug>("-> ", md5);
-		const auto modificationTime = FileLastModified(fixPath);
-		if (Log.Level >= LogLevel::Debug) Log.Write<LogLevel::Debug>("-> ", modificationTime);
-		fmd[fullPath] = V(md5, size, modificationTime);
-		LogInfo(file, md5, size, modificationTime);
+	};
+
+	struct KeyHash
+	{
+		std::size_t operator()(const Key& key) const
+		{
+			return std::hash<uint64_t>()(key.Inode * 0x9e3779b97f4a7c15ull ^ key.Device);
+		}
+	};
+
+	std::mutex mtx{};
+	std::unordered_map<Key, std::shared_future<Md5Digest>, KeyHash> digests{};
+};
+
+void FileMd5DatabaseAdd(const std::string& deviceName, const std::filesystem::path& file, Database& fmd, const HashAlgorithm algorithm)
+{
+	try
+	{
+		auto [k, v] = FileMd5DatabaseRecord(deviceName, file, algorithm);
+		fmd[k] = std::move(v);
 	}
 	catch (const std::exception& e)
 	{
@@ -185,90 +806,635 @@ void FileMd5DatabaseAdd(const std::string& deviceName, const std::filesystem::pa
 	}
 }
 
-void FileMd5DatabaseBuilder(const std::string& deviceName, const std::filesystem::path& path, Database& fmd, std::vector<std::string> skips)
+// a directory is complete once all of its files are merged and all of its subdirectories are complete,
+// the files merged into an incomplete directory are kept with it until then
+class WalkProgress
 {
-	std::error_code errorCode;
-	const std::error_code nonErrorCode;
-	std::deque<std::filesystem::path> queue{};
-	const std::filesystem::directory_iterator end;
-	queue.emplace_back(path);
-	while (!queue.empty())
+public:
+	explicit WalkProgress(std::string deviceName, const BuildProgress& resumed) :
+		deviceName(std::move(deviceName)),
+		completed(resumed.Directories),
+		skip(resumed.Directories.begin(), resumed.Directories.end()),
+		merged(resumed.Files.begin(), resumed.Files.end()) {}
+
+	[[nodiscard]] const std::string& DeviceName() const
 	{
-		try
+		return deviceName;
+	}
+
+	[[nodiscard]] std::string Key(const std::filesystem::path& path) const
+	{
+		auto key = deviceName;
+		String::StringCombine(key, ":", path.u8string());
+		return key;
+	}
+
+	// true if the subtree was completed by an earlier run
+	[[nodiscard]] bool Completed(const std::filesystem::path& dir) const
+	{
+		return skip.find(Key(dir)) != skip.end();
+	}
+
+	// true if an earlier run merged the file, alone or with a directory above it, unlike Merged it keeps no account
+	[[nodiscard]] bool Resumed(const std::filesystem::path& file) const
+	{
+		if (merged.find(Key(file)) != merged.end()) return true;
+		for (auto dir = file.parent_path(); !dir.empty(); dir = dir.parent_path())
+		{
+			if (Completed(dir)) return true;
+			if (dir == dir.root_path()) break;
+		}
+		return false;
+	}
+
+	// true if an earlier run merged the file, it then counts as merged into its directory by this run
+	[[nodiscard]] bool Merged(const std::filesystem::path& file)
+	{
+		std::lock_guard lock(mtx);
+		const auto pos = merged.find(Key(file));
+		if (pos == merged.end()) return false;
+		auto key = merged.extract(pos);
+		if (const auto node = nodes.find(file.parent_path().u8string()); node != nodes.end()) node->second.Files.push_back(std::move(key.value()));
+		return true;
+	}
+
+	void Directory(const std::filesystem::path& dir, const std::filesystem::path& parent)
+	{
+		std::lock_guard lock(mtx);
+		nodes[dir.u8string()] = { 1, parent.u8string(), true };
+		if (!parent.empty()) ++nodes.at(parent.u8string()).Pending;
+	}
+
+	void File(const std::filesystem::path& dir)
+	{
+		std::lock_guard lock(mtx);
+		++nodes.at(dir.u8string()).Pending;
+	}
+
+	void Done(const std::filesystem::path& dir, const bool ok = true)
+	{
+		std::lock_guard lock(mtx);
+		DoneImpl(dir.u8string(), ok);
+	}
+
+	// done with the directory of a merged record key
+	void DoneRecord(const K& key)
+	{
+		const auto dir = std::filesystem::u8path(key.substr(deviceName.length() + 1)).parent_path().u8string();
+		std::lock_guard lock(mtx);
+		if (const auto node = nodes.find(dir); node != nodes.end()) node->second.Files.push_back(key);
+		DoneImpl(dir, true);
+	}
+
+	[[nodiscard]] BuildProgress Progress()
+	{
+		std::lock_guard lock(mtx);
+		BuildProgress progress{ completed, { merged.begin(), merged.end() } };
+		for (const auto& [dir, node] : nodes)
+		{
+			progress.Files.insert(progress.Files.end(), node.Files.begin(), node.Files.end());
+		}
+		return progress;
+	}
+
+private:
+	struct Node
+	{
+		uint64_t Pending;
+		std::string Parent;
+		bool Ok;
+		std::vector<std::string> Files{};
+	};
+
+	void DoneImpl(const std::string& dir, const bool ok)
+	{
+		const auto pos = nodes.find(dir);
+		if (pos == nodes.end()) return;
+		auto& node = pos->second;
+		node.Ok = node.Ok && ok;
+		if (--node.Pending != 0) return;
+		const auto parent = std::move(node.Parent);
+		const auto nodeOk = node.Ok;
+		if (nodeOk) completed.push_back(Key(std::filesystem::u8path(dir)));
+		nodes.erase(pos);
+		if (!parent.empty()) DoneImpl(parent, nodeOk);
+	}
+
+	std::string deviceName;
+	std::mutex mtx{};
+	std::unordered_map<std::string, Node> nodes{};
+	std::vector<std::string> completed;
+	std::unordered_set<std::string> skip;
+	// merged by an earlier run into directories not listed again yet
+	std::unordered_set<std::string> merged;
+};
+
+static void FileMd5DatabaseList(const std::filesystem::path& dir, const PathMatcher& skip, Thread::BoundedChannel<FileEntry>& files,
+	WalkProgress& progress, const std::function<bool(const std::filesystem::path&)>& recorded, const std::function<void(std::filesystem::path)>& subdirectory)
+{
+	// listed files keep their directory open for openat until they are hashed, unless too many directories are open already
+	constexpr uint64_t maxSharedDirectories = 256;
+	auto ok = true;
+	try
+	{
+		const auto handle = std::make_shared<const ::File::Directory>(dir);
+		const auto share = ::File::Directory::OpenCount() <= maxSharedDirectories;
+		handle->List([&](const std::string& name, ::File::EntryType type)
 		{
-			for (std::filesystem::directory_iterator file(queue.front(), std::filesystem::directory_options::none, errorCode); file != end; ++file)
+			const auto file = dir / std::filesystem::u8path(name);
+			std::optional<::File::Status> status{};
+			if (type == ::File::EntryType::Regular || type == ::File::EntryType::Unknown)
 			{
-				if (errorCode != nonErrorCode)
+				status = handle->GetStatus(name);
+				if (status)
 				{
-					LogErr(file->path(), errorCode.message());
-					errorCode.clear();
-					continue;
+					type = status->Type;
 				}
-				if (file->is_symlink())
+				else if (type == ::File::EntryType::Unknown)
 				{
-					continue;
+					LogErr(file, "stat error");
+					ok = false;
+					return;
 				}
-				if (file->is_regular_file())
+			}
+			if (type == ::File::EntryType::Regular)
+			{
+				if (skip.Match(file.u8string()) || recorded(file))
 				{
-					if (std::find(skips.begin(), skips.end(), file->path().u8string()) != skips.end())
-					{
-						continue;
-					}
-					FileMd5DatabaseAdd(deviceName, file->path(), fmd);
+					return;
 				}
-				else if (file->is_directory())
+				progress.File(dir);
+				files.Write(FileMd5DatabaseEntry(progress.DeviceName(), file, share ? handle : nullptr, name, status));
+			}
+			else if (type == ::File::EntryType::Directory)
+			{
+				if (progress.Completed(file) || skip.Match(file.u8string()))
 				{
-					queue.emplace_back(file->path());
+					return;
 				}
+				progress.Directory(file, dir);
+				subdirectory(file);
+			}
+		});
+	}
+	catch (const std::exception& e)
+	{
+		LogErr(dir, e.what());
+		ok = false;
+	}
+	progress.Done(dir, ok);
+}
+
+static void FileMd5DatabaseWalker(const std::filesystem::path& path, const PathMatcher& skip, Thread::BoundedChannel<FileEntry>& files,
+	WalkProgress& progress, const std::function<bool(const std::filesystem::path&)>& recorded, const uint64_t walkThreads)
+{
+	// keep directory paths equal to the parent_path() of their entries
+	const auto root = path.has_filename() ? path : path.parent_path();
+	if (progress.Completed(root) || skip.Match(root.u8string())) return;
+	progress.Directory(root, {});
+
+	const auto walkerCount = std::max<uint64_t>(walkThreads, 1);
+	Thread::WorkStealingQueue<std::filesystem::path> dirs(walkerCount);
+	dirs.Push(0, root);
+	std::vector<std::thread> walkers{};
+	for (uint64_t i = 0; i < walkerCount; ++i)
+	{
+		walkers.emplace_back([&, i]()
+		{
+			while (const auto dir = dirs.Pop(i))
+			{
+				FileMd5DatabaseList(*dir, skip, files, progress, recorded, [&](std::filesystem::path subdirectory) { dirs.Push(i, std::move(subdirectory)); });
+				dirs.Done();
+			}
+		});
+	}
+	for (auto& walker : walkers) walker.join();
+}
+
+// sort key of a file under a read order, files without a known position go last
+// the device first, positions on different devices say nothing about seeks between them
+using OrderKey = std::pair<uint64_t, uint64_t>;
+
+static OrderKey FileMd5DatabaseOrderKey(const FileEntry& entry, const ReadOrder order)
+{
+	static const std::unordered_map<ReadOrder, std::function<OrderKey(const FileEntry&)>> keys
+	{
+		{ ReadOrder::Listing, [](const FileEntry&) { return OrderKey{}; } },
+		{ ReadOrder::Inode, [](const FileEntry& entry) { return OrderKey{ entry.Device, entry.Inode }; } },
+		{ ReadOrder::Extent, [](const FileEntry& entry)
+		{
+			constexpr auto unknown = std::numeric_limits<uint64_t>::max();
+			if (entry.Size == 0) return OrderKey{ entry.Device, unknown };
+			try
+			{
+				return OrderKey{ entry.Device, FileMd5DatabaseOpen(entry)->FirstExtent().value_or(unknown) };
 			}
+			catch (const std::exception&)
+			{
+				// the hash thread reports it when it fails to open the file again
+				return OrderKey{ entry.Device, unknown };
+			}
+		} }
+	};
+	return keys.at(order)(entry);
+}
+
+// passes the files on in order of their key, sorted within each batch of options.OrderBatch files only,
+// a file listed after a batch is flushed is read after that whole batch wherever it lies
+static void FileMd5DatabaseOrder(Thread::BoundedChannel<FileEntry>& files, Thread::BoundedChannel<FileEntry>& ordered, const BuilderOptions& options)
+{
+	const auto batchSize = std::max<uint64_t>(options.OrderBatch, 1);
+	std::vector<std::pair<OrderKey, FileEntry>> batch{};
+	const auto flush = [&]()
+	{
+		std::stable_sort(batch.begin(), batch.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+		for (auto& [key, entry] : batch) ordered.Write(std::move(entry));
+		batch.clear();
+	};
+	while (auto file = files.Read())
+	{
+		const auto key = FileMd5DatabaseOrderKey(*file, options.Order);
+		batch.emplace_back(key, std::move(*file));
+		if (batch.size() >= batchSize) flush();
+	}
+	flush();
+	ordered.Close();
+}
+
+// calls func for every index on up to threads threads
+static void FileMd5DatabaseParallel(const std::vector<std::size_t>& indices, const uint64_t threads, const std::function<void(std::size_t)>& func)
+{
+	std::atomic<std::size_t> next = 0;
+	std::vector<std::thread> workers{};
+	for (uint64_t i = 0; i < std::min<uint64_t>(threads, indices.size()); ++i)
+	{
+		workers.emplace_back([&]()
+		{
+			for (auto j = next++; j < indices.size(); j = next++) func(indices[j]);
+		});
+	}
+	for (auto& worker : workers) worker.join();
+}
+
+// sizes first, then the head and tail of the files sharing a size, then the full contents of the files sharing those too,
+// collisions are only looked for among the files of this build, a record is written as soon as it is settled
+static void FileMd5DatabaseDedup(std::vector<FileEntry>& entries, const Database& fmd, std::shared_mutex& fmdMtx, const BuilderOptions& options,
+	ReadPolicy& reads, const std::function<bool(const std::filesystem::path&)>& resumed, Thread::BoundedChannel<std::pair<K, V>>& records)
+{
+	enum class Stage { Unique, Partial, Full };
+	const auto threads = std::max<uint64_t>(options.Threads, 1);
+	std::unordered_map<uint64_t, uint64_t> sizes{};
+	for (const auto& entry : entries) ++sizes[entry.Size];
+
+	std::vector<std::optional<V>> previous(entries.size());
+	std::vector<Md5Digest> digests(entries.size());
+	std::vector<Stage> stages(entries.size(), Stage::Unique);
+	// files sharing their size with another and lacking a full digest from the previous build, per size
+	std::unordered_map<uint64_t, uint64_t> unknown{};
+	for (std::size_t i = 0; i < entries.size(); ++i)
+	{
+		const auto& entry = entries[i];
+		// what a resumed build merged is not read again, even when rehashing
+		if (!options.ForceRehash || resumed(entry.File)) previous[i] = FileMd5DatabasePrevious(entry, fmd, fmdMtx);
+		if (entry.Size == 0 || sizes[entry.Size] < 2) continue;
+		// a full digest is kept as it is and never traded for a partial one
+		if (const auto md5 = FileMd5DatabaseFull(previous[i]))
+		{
+			digests[i] = *md5;
+			stages[i] = Stage::Full;
+			continue;
+		}
+		++unknown[entry.Size];
+	}
+
+	std::vector<std::size_t> partial{};
+	std::vector<std::size_t> full{};
+	for (std::size_t i = 0; i < entries.size(); ++i)
+	{
+		const auto& entry = entries[i];
+		if (unknown.find(entry.Size) == unknown.end()) continue;
+		if (entry.Size <= PartialHashSize * 2)
+		{
+			// head and tail would cover the whole file anyway
+			if (stages[i] == Stage::Full) continue;
+			stages[i] = Stage::Full;
+			full.push_back(i);
 		}
-		catch (const std::exception& e)
+		else
 		{
-			LogErr(queue.front(), e.what());
+			// a file with a full digest still compares its head and tail with the files lacking one
+			if (stages[i] != Stage::Full) stages[i] = Stage::Partial;
+			partial.push_back(i);
 		}
-		queue.pop_front();
 	}
+
+	const auto write = [&](const std::size_t i, const Md5Digest& md5, const uint32_t flags)
+	{
+		records.Write(FileMd5DatabaseFinish(entries[i], md5, flags));
+	};
+	// a file that is not read keeps what the previous build knew of it
+	const auto unread = [&](const std::size_t i)
+	{
+		if (previous[i]) write(i, std::get<0>(*previous[i]), std::get<3>(*previous[i]) & RecordFlag::Partial);
+		else write(i, {}, 0);
+	};
+	// files of a unique size and full digests carried over are settled before the first file is read, only Path is
+	// taken from an entry and the later stages read files through File
+	for (std::size_t i = 0; i < entries.size(); ++i)
+	{
+		if (stages[i] == Stage::Unique) unread(i);
+		else if (stages[i] == Stage::Full && !IsNilMd5(digests[i])) write(i, digests[i], 0);
+	}
+
+	const auto order = [&](std::vector<std::size_t>& indices)
+	{
+		if (options.Order == ReadOrder::Listing) return;
+		std::vector<std::pair<OrderKey, std::size_t>> keys(indices.size());
+		std::transform(indices.begin(), indices.end(), keys.begin(), [&](const std::size_t i) { return std::pair(FileMd5DatabaseOrderKey(entries[i], options.Order), i); });
+		std::stable_sort(keys.begin(), keys.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+		std::transform(keys.begin(), keys.end(), indices.begin(), [](const auto& key) { return key.second; });
+	};
+
+	order(partial);
+	// a size is settled once the heads and tails of all its files are hashed, by the thread hashing the last of them
+	std::unordered_map<uint64_t, std::vector<std::size_t>> groups{};
+	for (const auto i : partial) groups[entries[i].Size].push_back(i);
+	std::unordered_map<uint64_t, std::size_t> left{};
+	for (const auto& [size, group] : groups) left[size] = group.size();
+	std::mutex groupMtx{};
+	std::vector<Md5Digest> partials(entries.size());
+	FileMd5DatabaseParallel(partial, threads, [&](const std::size_t i)
+	{
+		if (previous[i] && (std::get<3>(*previous[i]) & RecordFlag::Partial) && !IsNilMd5(std::get<0>(*previous[i])))
+		{
+			partials[i] = std::get<0>(*previous[i]);
+		}
+		else
+		{
+			partials[i] = FileMd5DatabasePartialHash(entries[i], options.Algorithm, reads);
+		}
+		{
+			std::lock_guard lock(groupMtx);
+			if (--left.at(entries[i].Size) != 0) return;
+		}
+
+		const auto& group = groups.at(entries[i].Size);
+		std::map<Md5Digest, uint64_t> heads{};
+		for (const auto j : group)
+		{
+			if (!IsNilMd5(partials[j])) ++heads[partials[j]];
+		}
+		for (const auto j : group)
+		{
+			if (stages[j] == Stage::Full) continue;
+			if (IsNilMd5(partials[j]))
+			{
+				stages[j] = Stage::Unique;
+				unread(j);
+			}
+			else if (heads[partials[j]] > 1)
+			{
+				stages[j] = Stage::Full;
+				std::lock_guard lock(groupMtx);
+				full.push_back(j);
+			}
+			else
+			{
+				write(j, partials[j], RecordFlag::Partial);
+			}
+		}
+	});
+
+	order(full);
+	InodeCache inodes{};
+	FileMd5DatabaseParallel(full, threads, [&](const std::size_t i)
+	{
+		auto& entry = entries[i];
+		const auto linked = entry.Links > 1 && entry.Inode != 0;
+		std::promise<Md5Digest> owner{};
+		if (linked)
+		{
+			if (const auto md5 = inodes.Lookup(entry, owner))
+			{
+				write(i, *md5, 0);
+				return;
+			}
+		}
+		const auto md5 = FileMd5DatabaseFull(previous[i]);
+		digests[i] = md5 ? *md5 : FileMd5DatabaseHash(entry, options.Algorithm, &reads);
+		if (linked) owner.set_value(digests[i]);
+		write(i, digests[i], 0);
+	});
 }
 
-void FileMd5DatabaseQuery(const std::vector<Model>& fmdRaw, const MatchMethod& matchMethod, const Data& queryData,
-	const Data& sortBy, const std::string& keyword, const uint64_t limit, const bool desc)
+void FileMd5DatabaseBuilder(const std::string& deviceName, const std::filesystem::path& path, Database& fmd, const std::vector<std::string>& skips, const BuilderOptions& options)
+{
+	const auto workerCount = std::max<uint64_t>(options.Threads, 1);
+	std::shared_mutex fmdMtx{};
+	Thread::BoundedChannel<FileEntry> files(workerCount * 256);
+	Thread::BoundedChannel<std::pair<K, V>> records(workerCount * 256);
+	// a dedup build lists what it resumed again, every size has to be counted
+	const auto dedup = options.Mode == BuildMode::Dedup;
+	WalkProgress progress(deviceName, options.Resume && !dedup ? options.Resumed : BuildProgress{});
+	const PathMatcher skip(skips);
+	ReadPolicy reads(options);
+	// every file is looked up, and merged records arrive out of path order anyway
+	fmd.Index();
+	if (options.Engine == IoEngine::Uring && options.QueueDepth != 0 && !::File::BatchReader(1).Async())
+	{
+		Log.Write<LogLevel::Info>("io_uring unavailable, reading files with blocking calls");
+	}
+
+	std::thread walker([&]()
+	{
+		FileMd5DatabaseWalker(path, skip, files, progress, [&](const std::filesystem::path& file)
+		{
+			return options.Resume && progress.Merged(file);
+		}, options.WalkThreads);
+		files.Close();
+	});
+
+	// the records merged since the last checkpoint, so that a checkpoint does not rewrite the whole database
+	Database pending{};
+	auto checkpointTime = std::chrono::steady_clock::now();
+	const auto merge = [&](std::pair<K, V> record)
+	{
+		if (options.Checkpoint) pending[record.first] = record.second;
+		{
+			std::unique_lock lock(fmdMtx);
+			fmd[record.first] = std::move(record.second);
+		}
+		progress.DoneRecord(record.first);
+		if (!options.Checkpoint) return;
+		const auto now = std::chrono::steady_clock::now();
+		if ((options.CheckpointFiles != 0 && pending.size() >= options.CheckpointFiles)
+			|| (options.CheckpointSeconds != 0 && now - checkpointTime >= std::chrono::seconds(options.CheckpointSeconds)))
+		{
+			options.Checkpoint(pending, progress.Progress());
+			pending = Database{};
+			checkpointTime = std::chrono::steady_clock::now();
+		}
+	};
+
+	if (dedup)
+	{
+		// every size has to be known before the first file is read
+		std::vector<FileEntry> entries{};
+		while (auto file = files.Read()) entries.push_back(std::move(*file));
+		walker.join();
+		const WalkProgress resumed(deviceName, options.Resume ? options.Resumed : BuildProgress{});
+		std::thread hasher([&]()
+		{
+			FileMd5DatabaseDedup(entries, fmd, fmdMtx, options, reads, [&](const std::filesystem::path& file) { return resumed.Resumed(file); }, records);
+			records.Close();
+		});
+		while (auto record = records.Read()) merge(std::move(*record));
+		hasher.join();
+		return;
+	}
+
+	// the hash threads read the walk directly or after the ordering stage
+	Thread::BoundedChannel<FileEntry> ordered(workerCount * 256);
+	auto& queue = options.Order == ReadOrder::Listing ? files : ordered;
+	std::thread scheduler{};
+	if (options.Order != ReadOrder::Listing) scheduler = std::thread([&]() { FileMd5DatabaseOrder(files, ordered, options); });
+
+	InodeCache inodes{};
+	std::atomic<uint64_t> running = workerCount;
+	std::vector<std::thread> workers{};
+	for (uint64_t i = 0; i < workerCount; ++i)
+	{
+		workers.emplace_back([&]()
+		{
+			{
+				SmallFileBatch batch(records, options, reads);
+				while (auto file = queue.Read())
+				{
+					try
+					{
+						auto& entry = *file;
+						if (entry.Links > 1 && entry.Inode != 0)
+						{
+							// hashed right away so no worker waits on a link sitting in its own batch
+							std::promise<Md5Digest> owner{};
+							if (const auto md5 = inodes.Lookup(entry, owner))
+							{
+								records.Write(FileMd5DatabaseFinish(entry, *md5));
+								continue;
+							}
+							auto md5 = options.ForceRehash ? std::nullopt : FileMd5DatabaseUnchanged(entry, fmd, fmdMtx);
+							if (!md5) md5 = FileMd5DatabaseHash(entry, options.Algorithm, &reads);
+							owner.set_value(*md5);
+							records.Write(FileMd5DatabaseFinish(entry, *md5));
+							continue;
+						}
+						if (!options.ForceRehash)
+						{
+							if (auto md5 = FileMd5DatabaseUnchanged(entry, fmd, fmdMtx))
+							{
+								records.Write(FileMd5DatabaseFinish(entry, *md5));
+								continue;
+							}
+						}
+						if (batch.Accept(entry))
+						{
+							batch.Add(std::move(entry));
+							continue;
+						}
+						const auto md5 = FileMd5DatabaseHash(entry, options.Algorithm, &reads);
+						records.Write(FileMd5DatabaseFinish(entry, md5));
+					}
+					catch (const std::exception& e)
+					{
+						LogErr(file->File, e.what());
+						progress.Done(file->File.parent_path(), false);
+					}
+				}
+			}
+			if (--running == 0) records.Close();
+		});
+	}
+
+	while (auto record = records.Read()) merge(std::move(*record));
+
+	walker.join();
+	if (scheduler.joinable()) scheduler.join();
+	for (auto& worker : workers) worker.join();
+}
+
+static void FileMd5DatabaseQueryPrint(std::vector<ModelRef>& res, const Data& sortBy, const uint64_t limit, const bool desc)
 {
-	puts(("load " + Convert::ToString(fmdRaw.size())).c_str());
-	std::vector<ModelRef> fmd(fmdRaw.size());
-	std::transform(std::execution::par_unseq, fmdRaw.begin(), fmdRaw.end(), fmd.begin(), [](const Model& model) { return ModelRef(std::string_view(model.Path.str, model.Path.size), std::string_view(model.Md5.str, model.Md5.size), model.Size, std::string_view(model.Time.str, model.Time.size)); });
-	std::vector<ModelRef> res(fmd.size());
-	ModelMatch(fmd, res, matchMethod, queryData, false, keyword);
 	ModelSort(res, sortBy);
 	if (desc) ModelReverse(res);
 	std::vector<ModelRef> out{};
-	std::copy_n(res.begin(), std::min(limit, res.size()), std::back_inserter(out));
+	std::copy_n(res.begin(), std::min(limit, static_cast<uint64_t>(res.size())), std::back_inserter(out));
 	ModelPrinter(out);
 }
 
+void FileMd5DatabaseQuery(const std::vector<ModelRef>& fmd, const MatchMethod& matchMethod, const Data& queryData,
+	const Data& sortBy, const std::string& keyword, const uint64_t limit, const bool desc)
+{
+	puts(("load " + Convert::ToString(fmd.size())).c_str());
+	std::vector<ModelRef> res{};
+	ModelMatch(fmd, res, matchMethod, queryData, false, keyword);
+	FileMd5DatabaseQueryPrint(res, sortBy, limit, desc);
+}
+
+void FileMd5DatabaseQuery(const ColumnStore& fmd, const MatchMethod& matchMethod, const Data& queryData,
+	const Data& sortBy, const std::string& keyword, const uint64_t limit, const bool desc)
+{
+	puts(("load " + Convert::ToString(fmd.Count)).c_str());
+	static const std::unordered_map<MatchMethod, ColumnScan::Op> scanOps
+	{
+		{ MatchMethod::Eq, ColumnScan::Op::Eq },
+		{ MatchMethod::Lt, ColumnScan::Op::Lt },
+		{ MatchMethod::Gt, ColumnScan::Op::Gt },
+	};
+	std::vector<ModelRef> res{};
+	if (const auto op = scanOps.find(matchMethod); op != scanOps.end() && (queryData == Data::Size || queryData == Data::Time))
+	{
+		std::vector<uint64_t> selection{};
+		if (queryData == Data::Size) ColumnScan::Scan(fmd.Size, fmd.Count, op->second, Convert::FromString<uint64_t>(keyword), selection);
+		else ColumnScan::Scan(fmd.Time, fmd.Count, op->second, TimestampFromString(keyword).Value, selection);
+		res.resize(selection.size());
+		std::transform(std::execution::par_unseq, selection.begin(), selection.end(), res.begin(), [&](const uint64_t i) { return fmd.At(i); });
+	}
+	else
+	{
+		std::vector<ModelRef> models(fmd.Count);
+		std::for_each(std::execution::par_unseq, models.begin(), models.end(), [&](ModelRef& model) { model = fmd.At(static_cast<uint64_t>(&model - models.data())); });
+		ModelMatch(models, res, matchMethod, queryData, false, keyword);
+	}
+	FileMd5DatabaseQueryPrint(res, sortBy, limit, desc);
+}
+
 void ModelPrinter(const std::vector<ModelRef>& fmd)
 {
+	if (fmd.empty()) return;
 	std::vector<ModelStr> out{};
 	std::transform(fmd.begin(), fmd.end(), std::back_inserter(out), [](const ModelRef& model)
 	{
 		ModelStr mod;
+		const auto path = model.Path();
 		try
 		{
-			mod.Path = std::filesystem::u8path(model.Path).string();
+			mod.Path = std::filesystem::u8path(path).string();
 		}
 		catch (...)
 		{
-			mod.Path = model.Path;
+			mod.Path = path;
 		}
-		mod.Md5 = model.Md5;
+		mod.Md5 = Md5ToString(model.Md5);
 		mod.Size = Convert::ToString(model.Size);
-		mod.Time = model.Time;
+		mod.Time = TimestampToString(model.Time);
+		mod.Flags = RecordFlagsToString(model.Flags);
 		return mod;
 	});
 	const auto maxPathLen = std::max_element(out.begin(), out.end(), [](const ModelStr& a, const ModelStr& b) { return std::less<>()(a.Path.length(), b.Path.length()); })->Path.length();
 	const auto maxSizeLen = std::max_element(out.begin(), out.end(), [](const ModelStr& a, const ModelStr& b) { return std::less<>()(a.Size.length(), b.Size.length()); })->Size.length();
-	for (const auto& [p, m, s, t] : out)
+	for (const auto& [p, m, s, t, f] : out)
 	{
-		std::cout << p << std::string(maxPathLen - p.length(), ' ') << " | " << (m.empty() ? std::string(32, ' ') : m) << " | " << std::string(maxSizeLen - s.length(), ' ') << s << " | " << (t.empty() ? std::string(19, ' ') : t) << "\n";
+		std::cout << p << std::string(maxPathLen - p.length(), ' ') << " | " << (m.empty() ? std::string(2 * Md5Digest::Len, ' ') : m) << " | " << std::string(maxSizeLen - s.length(), ' ') << s << " | " << (t.empty() ? std::string(19, ' ') : t) << (f.empty() ? "" : " | " + f) << "\n";
 	}
 }
 
@@ -360,16 +1526,18 @@ void Export(Database& fmd, const std::string& path, const ExportFormat& format)
 	if (format == ExportFormat::CSV)
 	{
 		CsvFile csv(path, ",");
-		for (const auto& [k, v] : fmd)
+		for (const auto* record : fmd.Ordered())
 		{
+			const auto& [k, v] = *record;
 			const auto splitPos = k.find(':');
-			auto _path = k.substr(splitPos + 1);
+			auto _path = std::string(k.substr(splitPos + 1));
 			std::replace(_path.begin(), _path.end(), '\\', '/');
 			csv << _path
-				<< k.substr(0, splitPos)
-				<< std::get<0>(v)
+				<< std::string(k.substr(0, splitPos))
+				<< Md5ToString(std::get<0>(v))
 				<< Convert::ToString(std::get<1>(v))
-				<< std::get<2>(v)
+				<< TimestampToString(std::get<2>(v))
+				<< RecordFlagsToString(std::get<3>(v))
 				<< CsvFile::EndRow;
 		}
 	}
@@ -1,13 +1,22 @@
 #pragma once
 
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
+#include <functional>
 #include <future>
 #include <map>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
+#include <limits>
+#include <optional>
 #include <execution>
 #include <regex>
 
 #include "Convert.h"
+#include "Cryptography.h"
 #include "Thread.h"
 #include "Arguments.h"
 
@@ -16,6 +25,15 @@ ArgumentOptionHpp(MatchMethod, Contain, StartWith, EndWith, Regex, Eq, Gt, Lt)
 ArgumentOptionHpp(Data, Path, Md5, Size, Time)
 ArgumentOptionHpp(ExportFormat, CSV, JSON)
 ArgumentOptionHpp(AlterType, DeviceName, DriveLetter)
+// Block is the smallest on disk but its records are decoded on every load, it loads faster than Row only from cold, slow
+// storage and is never chosen unless asked for
+ArgumentOptionHpp(StorageLayout, Row, Columnar, Block)
+ArgumentOptionHpp(IoEngine, Blocking, Uring)
+ArgumentOptionHpp(BuildMode, Full, Dedup)
+ArgumentOptionHpp(ReadOrder, Listing, Inode, Extent)
+ArgumentOptionHpp(IoMode, Buffered, Fadvise, Direct)
+// the ids are stored in the database header, append only
+ArgumentOptionHpp(HashAlgorithm, Md5, Sha256, Blake3, Xxh64)
 
 class Logger
 {
@@ -51,22 +69,163 @@ private:
 
 static Logger Log;
 
-using K = std::string;
-using V = std::tuple<std::string, uint64_t, std::string>;
-using Database = std::map<K, V>;
+// the digest of a record in 16 bytes whatever the algorithm, every digest of the process has the length Len of the database
+// being worked on, digests of up to 16 bytes are held in place and zero padded, longer ones point to their bytes, which live
+// in a pool kept for the whole process or, for a View, in the mapping they were read from
+class Md5Digest
+{
+public:
+	static constexpr uint64_t InlineLen = 16;
+	static inline uint64_t Len = 16;
+
+	Md5Digest() = default;
+	// the first len bytes of the digest, the rest are zero
+	Md5Digest(const uint8_t* data, uint64_t len = Len);
+
+	// Len bytes at data, referenced rather than copied when they do not fit in place
+	static Md5Digest View(const uint8_t* data);
+	// a copy that no longer references where a View was read from
+	[[nodiscard]] Md5Digest Owned() const;
+
+	// Len bytes, InlineLen when Len is shorter
+	[[nodiscard]] const uint8_t* Data() const;
+	[[nodiscard]] bool Nil() const { return data.QWord[0] == 0 && data.QWord[1] == 0; }
+
+	friend bool operator==(const Md5Digest& a, const Md5Digest& b)
+	{
+		if (a.data.QWord[0] == b.data.QWord[0] && a.data.QWord[1] == b.data.QWord[1]) return true;
+		return Len > InlineLen && !a.Nil() && !b.Nil() && memcmp(a.data.Wide, b.data.Wide, Len) == 0;
+	}
 
-struct StrPtr
+	// byte-wise order, the same order as the hex strings
+	friend bool operator<(const Md5Digest& a, const Md5Digest& b)
+	{
+		return memcmp(a.Data(), b.Data(), std::max(Len, InlineLen)) < 0;
+	}
+
+private:
+	union
+	{
+		uint8_t Word[InlineLen];
+		uint64_t QWord[2];
+		const uint8_t* Wide;
+	} data{};
+};
+
+inline bool operator!=(const Md5Digest& a, const Md5Digest& b)
 {
-	char* str;
-	uint64_t size;
+	return !(a == b);
+}
+
+inline bool operator>(const Md5Digest& a, const Md5Digest& b)
+{
+	return b < a;
+}
+
+inline bool IsNilMd5(const Md5Digest& md5)
+{
+	return md5.Nil();
+}
+
+// bytes of the whole digest of algorithm
+uint8_t DigestLen(HashAlgorithm algorithm);
+
+std::string Md5ToString(const Md5Digest& md5);
+
+Md5Digest Md5FromString(const std::string& md5);
+
+struct Timestamp
+{
+	int64_t Value = std::numeric_limits<int64_t>::min();
 };
 
-struct Model
+inline bool IsNilTime(const Timestamp& time)
 {
-	StrPtr Path;
-	StrPtr Md5;
-	uint64_t Size;
-	StrPtr Time;
+	return time.Value == std::numeric_limits<int64_t>::min();
+}
+
+inline bool operator==(const Timestamp& a, const Timestamp& b) { return a.Value == b.Value; }
+inline bool operator!=(const Timestamp& a, const Timestamp& b) { return a.Value != b.Value; }
+inline bool operator<(const Timestamp& a, const Timestamp& b) { return a.Value < b.Value; }
+inline bool operator>(const Timestamp& a, const Timestamp& b) { return a.Value > b.Value; }
+
+std::string TimestampToString(const Timestamp& time);
+
+std::optional<Timestamp> ParseLocalTime(std::string_view time);
+
+// "YYYY-MM-DD[ HH:MM:SS]" local time, "@<epoch seconds>" or "-<n>[s|m|h|d|w]" before now
+Timestamp TimestampFromString(const std::string& time);
+
+// "<n>[K|M|G|T]" in powers of 1024
+uint64_t ByteSizeFromString(const std::string& size);
+
+// per record flags, stored since format version 6
+namespace RecordFlag
+{
+	// the file has more than one link, its digest may have been taken from another link to the same inode
+	constexpr uint32_t Hardlink = 1;
+	// the digest covers only the head and tail of the file, written by dedup builds and never trusted as a duplicate
+	constexpr uint32_t Partial = 2;
+}
+
+std::string RecordFlagsToString(uint32_t flags);
+
+using K = std::string;
+using V = std::tuple<Md5Digest, uint64_t, Timestamp, uint32_t>;
+
+// records by path in a flat vector of fixed size entries, the paths live in an arena of a few large chunks owned by the database,
+// records appended in path order are found by binary search until the first one out of order or Index builds a hash index of their positions
+class Database
+{
+public:
+	using Record = std::pair<std::string_view, V>;
+	using iterator = std::vector<Record>::iterator;
+	using const_iterator = std::vector<Record>::const_iterator;
+
+	Database() : arena(std::make_unique<std::pmr::monotonic_buffer_resource>()) {}
+	// the arena moves by pointer, so the paths stay where they are
+	Database(Database&&) noexcept = default;
+	Database& operator=(Database&&) noexcept = default;
+	Database(const Database&) = delete;
+	Database& operator=(const Database&) = delete;
+
+	[[nodiscard]] std::size_t size() const { return records.size(); }
+	[[nodiscard]] bool empty() const { return records.empty(); }
+	// insertion order, see Ordered
+	iterator begin() { return records.begin(); }
+	iterator end() { return records.end(); }
+	[[nodiscard]] const_iterator begin() const { return records.begin(); }
+	[[nodiscard]] const_iterator end() const { return records.end(); }
+
+	iterator find(std::string_view path);
+	[[nodiscard]] const_iterator find(std::string_view path) const;
+
+	// keeps the existing record like std::map::emplace, iterators stay valid unless the vector grows
+	std::pair<iterator, bool> emplace(std::string_view path, const V& v);
+
+	V& operator[](const std::string_view path) { return emplace(path, V{}).first->second; }
+
+	// adds the records of other whose paths are not here yet
+	void merge(const Database& other);
+
+	void reserve(std::size_t count);
+
+	// builds the hash index now rather than on the first record out of order
+	void Index();
+
+	// the records in path order, sorted only when they were not inserted in that order
+	[[nodiscard]] std::vector<const Record*> Ordered() const;
+
+private:
+	// the index slot holding path, or the empty slot where it would go
+	[[nodiscard]] std::size_t Probe(std::string_view path) const;
+	void Rehash(std::size_t slots);
+
+	std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+	std::vector<Record> records{};
+	// position + 1 of a record, 0 is empty, a power of two at most half full, empty until built and always built once unsorted
+	std::vector<uint32_t> index{};
+	bool sorted = true;
 };
 
 struct ModelStr
@@ -75,17 +234,88 @@ struct ModelStr
 	std::string Md5;
 	std::string Size;
 	std::string Time;
+	std::string Flags;
+};
+
+// the directories of a database from format version 8, directory i is the path of Parents[i] followed by
+// Names[NameOffsets[i], NameOffsets[i + 1]), a name ending in its separator, directory 0 is the empty path
+// and the ids follow the order of the paths, so the directories under a prefix are a range of ids
+struct PathTree
+{
+	static constexpr std::string_view Separators = "/\\";
+
+	uint64_t Count = 0;
+	const uint32_t* Parents = nullptr;
+	const uint64_t* NameOffsets = nullptr;
+	const char* Names = nullptr;
+
+	// backing storage for columns that cannot be used in place, e.g. on big-endian hosts
+	std::vector<uint32_t> OwnedParents{};
+	std::vector<uint64_t> OwnedNameOffsets{};
+	// the decoded blocks of the block layout, the directory table and the record names reference them
+	std::vector<std::unique_ptr<char[]>> OwnedBlocks{};
+
+	[[nodiscard]] std::string_view Name(const uint32_t dir) const
+	{
+		return { Names + NameOffsets[dir], NameOffsets[dir + 1] - NameOffsets[dir] };
+	}
+
+	void AppendPath(std::string& out, uint32_t dir) const;
+	[[nodiscard]] std::string Path(uint32_t dir) const;
+	// the ids of the directories whose path starts with prefix
+	[[nodiscard]] std::pair<uint32_t, uint32_t> PrefixRange(std::string_view prefix) const;
+	[[nodiscard]] std::optional<uint32_t> Find(std::string_view path) const;
 };
 
 struct ModelRef
 {
-	std::string_view Path;
-	std::string_view Md5;
+	// the path is directory Dir of Tree followed by Name, without a tree Name is the whole path
+	const PathTree* Tree;
+	uint32_t Dir;
+	std::string_view Name;
+	Md5Digest Md5;
 	uint64_t Size;
-	std::string_view Time;
+	Timestamp Time;
+	uint32_t Flags;
 
-	ModelRef(const std::string_view& path, const std::string_view& md5, uint64_t size, const std::string_view& time);
+	ModelRef(const std::string_view& path, const Md5Digest& md5, uint64_t size, const Timestamp& time, uint32_t flags = 0);
+	ModelRef(const PathTree* tree, uint32_t dir, const std::string_view& name, const Md5Digest& md5, uint64_t size, const Timestamp& time, uint32_t flags = 0);
 	ModelRef();
+
+	// rebuilt from the tree on every call
+	[[nodiscard]] std::string Path() const;
+	void AppendPath(std::string& out) const;
+};
+
+// one array per field, the path of record i is Paths[PathOffsets[i], PathOffsets[i + 1]),
+// from format version 8 only its name, the rest is directory Dirs[i] of Tree
+struct ColumnStore
+{
+	uint64_t Count = 0;
+	const uint64_t* PathOffsets = nullptr;
+	const char* Paths = nullptr;
+	// Md5Len bytes per record
+	const uint8_t* Md5 = nullptr;
+	uint64_t Md5Len = 0;
+	const uint64_t* Size = nullptr;
+	const int64_t* Time = nullptr;
+	// null before format version 6
+	const uint32_t* Flags = nullptr;
+	// null before format version 8
+	const uint32_t* Dirs = nullptr;
+	const PathTree* Tree = nullptr;
+
+	// backing storage for columns that cannot be used in place, e.g. on big-endian hosts
+	std::vector<uint64_t> OwnedPathOffsets{};
+	std::vector<uint64_t> OwnedSize{};
+	std::vector<int64_t> OwnedTime{};
+	std::vector<uint32_t> OwnedFlags{};
+	std::vector<uint32_t> OwnedDirs{};
+
+	[[nodiscard]] ModelRef At(const uint64_t i) const
+	{
+		return { Dirs ? Tree : nullptr, Dirs ? Dirs[i] : 0, std::string_view(Paths + PathOffsets[i], PathOffsets[i + 1] - PathOffsets[i]), Md5Digest::View(Md5 + i * Md5Len), Size[i], Timestamp{ Time[i] }, Flags ? Flags[i] : 0 };
+	}
 };
 
 template <typename T = void> struct IntCmp {};
@@ -120,7 +350,7 @@ template<typename Model>
 struct DataToMember<Data::Md5, Model> { constexpr auto operator()(const Model& model) const { return model.Md5; } };
 
 template<typename Model>
-struct DataToMember<Data::Path, Model> { constexpr auto operator()(const Model& model) const { return model.Path; } };
+struct DataToMember<Data::Path, Model> { auto operator()(const Model& model) const { return model.Path(); } };
 
 template<typename Model>
 struct DataToMember<Data::Size, Model> { constexpr auto operator()(const Model& model) const { return model.Size; } };
@@ -161,12 +391,22 @@ constexpr auto ModelSortImpl(Fmd& fmd, const Cmp& cmp)
 	std::sort(std::execution::par_unseq, fmd.begin(), fmd.end(), cmp);
 }
 
+// paths are rebuilt once per record rather than twice per comparison
 template<typename Fmd>
-constexpr void ModelSort(Fmd& fmd, const Data& sortBy)
+void ModelSortByPath(Fmd& fmd)
 {
-	if      (sortBy == Data::Time) ModelSortImpl(fmd, ModelStringCmp<Data::Time>());
-	else if (sortBy == Data::Md5 ) ModelSortImpl(fmd, ModelStringCmp<Data::Md5 >());
-	else if (sortBy == Data::Path) ModelSortImpl(fmd, ModelStringCmp<Data::Path>());
+	std::vector<std::pair<std::string, typename Fmd::value_type>> keyed(fmd.size());
+	std::transform(std::execution::par_unseq, fmd.begin(), fmd.end(), keyed.begin(), [](const auto& model) { return std::make_pair(model.Path(), model); });
+	std::sort(std::execution::par_unseq, keyed.begin(), keyed.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+	std::transform(std::execution::par_unseq, keyed.begin(), keyed.end(), fmd.begin(), [](const auto& pair) { return pair.second; });
+}
+
+template<typename Fmd>
+void ModelSort(Fmd& fmd, const Data& sortBy)
+{
+	if      (sortBy == Data::Time) ModelSortImpl(fmd, ModelIntCmp   <Data::Time>());
+	else if (sortBy == Data::Md5 ) ModelSortImpl(fmd, ModelIntCmp   <Data::Md5 >());
+	else if (sortBy == Data::Path) ModelSortByPath(fmd);
 	else if (sortBy == Data::Size) ModelSortImpl(fmd, ModelIntCmp   <Data::Size>());
 }
 
@@ -190,6 +430,16 @@ struct RegexMatch
 	{
 		return operator()(Convert::ToString(v));
 	}
+
+	bool operator()(const Md5Digest& v) const
+	{
+		return operator()(Md5ToString(v));
+	}
+
+	bool operator()(const Timestamp& v) const
+	{
+		return operator()(TimestampToString(v));
+	}
 	
 	std::regex Keyword;
 };
@@ -210,6 +460,16 @@ struct ContainMatch
 		return operator()(Convert::ToString(v));
 	}
 
+	bool operator()(const Md5Digest& v) const
+	{
+		return operator()(Md5ToString(v));
+	}
+
+	bool operator()(const Timestamp& v) const
+	{
+		return operator()(TimestampToString(v));
+	}
+
 	std::string Keyword;
 };
 
@@ -232,6 +492,16 @@ struct StartWithMatch
 		return operator()(Convert::ToString(v));
 	}
 
+	bool operator()(const Md5Digest& v) const
+	{
+		return operator()(Md5ToString(v));
+	}
+
+	bool operator()(const Timestamp& v) const
+	{
+		return operator()(TimestampToString(v));
+	}
+
 	std::string Keyword;
 };
 
@@ -254,6 +524,16 @@ struct EndWithMatch
 		return operator()(Convert::ToString(v));
 	}
 
+	bool operator()(const Md5Digest& v) const
+	{
+		return operator()(Md5ToString(v));
+	}
+
+	bool operator()(const Timestamp& v) const
+	{
+		return operator()(TimestampToString(v));
+	}
+
 	std::string Keyword;
 };
 
@@ -293,6 +573,14 @@ struct BaseMatchImpl
 		{
 			Keyword = Convert::FromString<std::uint64_t>(keyword);
 		}
+		else if constexpr (std::is_same_v<TKeyword, Md5Digest>)
+		{
+			Keyword = Md5FromString(keyword);
+		}
+		else if constexpr (std::is_same_v<TKeyword, Timestamp>)
+		{
+			Keyword = TimestampFromString(keyword);
+		}
 		else
 		{
 			Keyword = keyword;
@@ -310,6 +598,8 @@ struct BaseMatchImpl
 
 template<typename SubMatch, Data DataValue> struct BaseMatch                       { using Type = BaseMatchImpl<std::string,   SubMatch>; };
 template<typename SubMatch>                 struct BaseMatch<SubMatch, Data::Size> { using Type = BaseMatchImpl<std::uint64_t, SubMatch>; };
+template<typename SubMatch>                 struct BaseMatch<SubMatch, Data::Md5 > { using Type = BaseMatchImpl<Md5Digest,     SubMatch>; };
+template<typename SubMatch>                 struct BaseMatch<SubMatch, Data::Time> { using Type = BaseMatchImpl<Timestamp,     SubMatch>; };
 
 template<Data MatchData, bool Neg, typename TMatcher>
 struct ModelMatcher
@@ -317,9 +607,21 @@ struct ModelMatcher
 	explicit ModelMatcher(const std::string& keyword): Matcher(keyword) {}
 
 	template<typename V>
-	constexpr ModelRef operator()(const V& value) const
+	ModelRef operator()(const V& value) const
 	{
-		auto res = Matcher(DataToMember<MatchData, V>()(value));
+		bool res;
+		if constexpr (MatchData == Data::Path)
+		{
+			// rebuilt into one buffer per thread rather than a new string per record
+			thread_local std::string path{};
+			path.clear();
+			value.AppendPath(path);
+			res = Matcher(std::string_view(path));
+		}
+		else
+		{
+			res = Matcher(DataToMember<MatchData, V>()(value));
+		}
 		if constexpr (Neg) res = !res;
 		return res ? value : ModelRef();
 	}
@@ -327,16 +629,48 @@ struct ModelMatcher
 	TMatcher Matcher;
 };
 
+// StartWith on the paths of one tree compares directory ids against the range under the keyword, plus the names
+// in the directory the keyword ends in, instead of rebuilding every path
+template<bool Neg>
+struct PathStartWithMatcher
+{
+	PathStartWithMatcher(const std::string& keyword, const PathTree* tree) : Tree(tree), Matcher(keyword)
+	{
+		if (!Tree) return;
+		Range = Tree->PrefixRange(keyword);
+		const auto split = keyword.find_last_of(PathTree::Separators);
+		const auto dir = split == std::string::npos ? std::string_view{} : std::string_view(keyword).substr(0, split + 1);
+		Rest = keyword.substr(dir.length());
+		if (!Rest.empty()) Partial = Tree->Find(dir);
+	}
+
+	ModelRef operator()(const ModelRef& value) const
+	{
+		auto res = value.Tree && value.Tree == Tree
+			? (value.Dir >= Range.first && value.Dir < Range.second) || (Partial == value.Dir && value.Name.substr(0, Rest.length()) == Rest)
+			: Matcher(value.Path());
+		if constexpr (Neg) res = !res;
+		return res ? value : ModelRef();
+	}
+
+	const PathTree* Tree;
+	StartWithMatch Matcher;
+	std::pair<uint32_t, uint32_t> Range{};
+	std::string Rest{};
+	std::optional<uint32_t> Partial{};
+};
+
 inline bool IsNilModel(const ModelRef& model)
 {
-	return model.Path.length() != 0;
+	return model.Name.length() != 0;
 }
 
 template<MatchMethod Method, Data MatchData, bool Neg, typename T>
 void ModelMatchImplImplImpl(const T& data, std::vector<ModelRef>& result, const std::string& keyword)
 {
 	std::vector<ModelRef> tmp(data.size());
-	     if constexpr (Method == MatchMethod::Contain  ) std::transform(std::execution::par_unseq, data.begin(), data.end(), tmp.begin(), ModelMatcher<MatchData, Neg, ContainMatch                               >(keyword));
+	     if constexpr (Method == MatchMethod::StartWith && MatchData == Data::Path) std::transform(std::execution::par_unseq, data.begin(), data.end(), tmp.begin(), PathStartWithMatcher<Neg>(keyword, data.empty() ? nullptr : data.begin()->Tree));
+	else if constexpr (Method == MatchMethod::Contain  ) std::transform(std::execution::par_unseq, data.begin(), data.end(), tmp.begin(), ModelMatcher<MatchData, Neg, ContainMatch                               >(keyword));
 	else if constexpr (Method == MatchMethod::Regex    ) std::transform(std::execution::par_unseq, data.begin(), data.end(), tmp.begin(), ModelMatcher<MatchData, Neg, RegexMatch                                 >(keyword));
 	else if constexpr (Method == MatchMethod::StartWith) std::transform(std::execution::par_unseq, data.begin(), data.end(), tmp.begin(), ModelMatcher<MatchData, Neg, StartWithMatch                             >(keyword));
 	else if constexpr (Method == MatchMethod::EndWith  ) std::transform(std::execution::par_unseq, data.begin(), data.end(), tmp.begin(), ModelMatcher<MatchData, Neg, EndWithMatch                               >(keyword));
@@ -384,11 +718,70 @@ void FileMd5DatabaseInit(const LogLevel& level = LogLevel::Info, const std::file
 
 void FileMd5DatabaseEnd();
 
-void FileMd5DatabaseAdd(const std::string& deviceName, const std::filesystem::path& file, Database& fmd);
+void FileMd5DatabaseAdd(const std::string& deviceName, const std::filesystem::path& file, Database& fmd, HashAlgorithm algorithm = HashAlgorithm::Md5);
+
+// what an interrupted build has merged, directories by key are complete with their subtrees,
+// files by key were merged into directories that are not complete yet
+struct BuildProgress
+{
+	std::vector<std::string> Directories{};
+	std::vector<std::string> Files{};
+};
+
+struct BuilderOptions
+{
+	uint64_t Threads = 1;
+	// directories listed concurrently, independent of the hash threads
+	uint64_t WalkThreads = 1;
+	bool ForceRehash = false;
+	// Dedup hashes only files sharing a size with another file of this build, head and tail first,
+	// in full only when those collide too, the rest keep their previous digest or none
+	BuildMode Mode = BuildMode::Full;
+	// the Md5 fields hold the first Md5Digest::Len bytes of the digests of Algorithm, zero padded if it is shorter
+	HashAlgorithm Algorithm = HashAlgorithm::Md5;
+
+	// Uring reads up to QueueDepth small files per hash thread at once and falls back to Blocking where io_uring is unavailable
+	IoEngine Engine = IoEngine::Blocking;
+	uint32_t QueueDepth = 64;
+	// Fadvise drops what was read from the page cache, Direct bypasses it and reads unaligned tails buffered
+	IoMode ReadMode = IoMode::Buffered;
+
+	// files are handed to the hash threads sorted by device, then inode number or first physical extent, against seeks
+	// on rotating disks, the order holds within each batch of OrderBatch files only and not across the whole build,
+	// one hash thread reads them strictly in that order
+	ReadOrder Order = ReadOrder::Listing;
+	uint64_t OrderBatch = 4096;
+
+	// files read at once from one device (st_dev) and bytes read per second by all hash threads, 0 is unlimited,
+	// a batch of small files counts as one read of each device it touches
+	uint64_t MaxDeviceReads = 0;
+	uint64_t MaxReadBps = 0;
+
+	// Checkpoint receives the records merged since the previous checkpoint and the progress of this build, including what
+	// it resumed, it is called every CheckpointFiles records or CheckpointSeconds seconds, 0 disables either trigger
+	uint64_t CheckpointFiles = 0;
+	uint64_t CheckpointSeconds = 0;
+	std::function<void(const Database&, const BuildProgress&)> Checkpoint{};
+
+	// skip what the interrupted build of Resumed merged without looking at it, other files already in the database
+	// are checked for changes like in any build, a Dedup build lists those files again for their sizes and keeps their
+	// records without reading them
+	bool Resume = false;
+	BuildProgress Resumed{};
+};
+
+void FileMd5DatabaseBuilder(const std::string& deviceName, const std::filesystem::path& path, Database& fmd, const std::vector<std::string>& skips, const BuilderOptions& options);
 
-void FileMd5DatabaseBuilder(const std::string& deviceName, const std::filesystem::path& path, Database& fmd, std::vector<std::string> skips);
+void FileMd5DatabaseQuery(const std::vector<ModelRef>& fmd,
+	const MatchMethod& matchMethod,
+	const Data& queryData,
+	const Data& sortBy,
+	const std::string& keyword,
+	uint64_t limit,
+	bool desc);
 
-void FileMd5DatabaseQuery(const std::vector<Model>& fmdRaw,
+// Eq/Lt/Gt on Size and Time scan the columns directly, everything else is matched on materialized records
+void FileMd5DatabaseQuery(const ColumnStore& fmd,
 	const MatchMethod& matchMethod,
 	const Data& queryData,
 	const Data& sortBy,
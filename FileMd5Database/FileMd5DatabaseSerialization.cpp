@@ -1,9 +1,16 @@
 #include "FileMd5DatabaseSerialization.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstring>
+#include <execution>
 #include <fstream>
+#include <limits>
+#include <optional>
 
 #include "Bit.h"
+#include "Lz.h"
 
 template<typename T>
 union IntBytes
@@ -12,118 +19,1197 @@ union IntBytes
 	char bytes[sizeof(T)];
 };
 
+using Uint32Bytes = IntBytes<uint32_t>;
 using Uint64Bytes = IntBytes<uint64_t>;
 
-static const auto NilString = "";
+static constexpr char Magic[8]{ 'F', 'M', 'D', '5', 'D', 'B', '\0', '\0' };
+static constexpr uint32_t Version = 10;
+static constexpr uint64_t HeaderLen = 32;
 
-void Serialization(const Database& fmd, const std::filesystem::path& databasePath)
+// version 5 flags, without ColumnarFlag the records follow the header row by row like version 4
+static constexpr uint32_t ColumnarFlag = 1;
+// version 7 keeps the hash algorithm in bits 8-15 of the flags, earlier versions are md5
+static constexpr uint32_t AlgorithmShift = 8;
+static constexpr uint32_t AlgorithmMask = 0xffu << AlgorithmShift;
+// version 9 block layout, see SerializationBlocks, an archive format that trades decoding time for size
+static constexpr uint32_t BlocksFlag = 2;
+// version 10 keeps the digest length in bits 16-23 of the flags and stores that many bytes of every digest,
+// earlier versions store 16 bytes, the digests of other lengths cut or zero padded
+static constexpr uint32_t DigestLenShift = 16;
+static constexpr uint32_t DigestLenMask = 0xffu << DigestLenShift;
+
+// the columnar layout stores a table of section offsets at IndexOffset, each section is aligned for in-place use,
+// version 5 has no flags section, version 8 adds the directory of every record and the directory table
+enum ColumnSection { PathOffsetsSection, PathsSection, Md5Section, SizeSection, TimeSection, FlagsSection, DirSection, TreeSection, SectionCount };
+static constexpr uint64_t SectionAlign = 64;
+
+// version 8 stores the name of a record and the id of its directory instead of its path, the directory table is
+// [u64 count][u64 name offsets, count + 1][u32 parents, count][names], see PathTree, it follows the index of the row layout
+// at the next section alignment and is a section of the columnar layout
+static constexpr uint64_t DirLen = 4;
+
+// blocks are [u32 raw length][u32 stored length][u32 record count][u32 block flags][data], the data is compressed
+// when that makes it smaller, block 0 is the directory table and the others hold up to BlockRecords records
+static constexpr uint64_t BlockHeaderLen = 16;
+static constexpr uint32_t BlockCompressed = 1;
+static constexpr uint64_t BlockRecords = 4096;
+// blocks encoded at once while writing
+static constexpr uint64_t BlockBatch = 256;
+
+// log entries are [u64 path length][path][md5][u64 size][i64 time][u32 flags][u32 crc32 of the entry], version 1 has no flags,
+// version 3 keeps the digest length after the version like the database does, earlier versions store 16 bytes
+static constexpr char LogMagic[8]{ 'F', 'M', 'D', '5', 'W', 'A', 'L', '\0' };
+static constexpr uint32_t LogVersion = 3;
+static constexpr uint64_t LogHeaderLen = 16;
+static constexpr uint64_t LogCrcLen = 4;
+
+// progress files are [u64 count] then [u64 length][directory] per entry, version 2 follows them with the merged files
+// of incomplete directories the same way
+static constexpr char ProgressMagic[8]{ 'F', 'M', 'D', '5', 'P', 'R', 'G', '\0' };
+static constexpr uint32_t ProgressVersion = 2;
+static constexpr uint64_t ProgressHeaderLen = 24;
+
+// digests before database version 10 and log version 3
+static constexpr uint64_t Md5Len = 16;
+static constexpr uint64_t Md5HexLen = 32;
+static constexpr uint64_t SizeLen = 8;
+static constexpr uint64_t TimeLen = 8;
+static constexpr uint64_t TimeTextLen = 19;
+static constexpr uint64_t FlagsLen = 4;
+// a block record takes at least a byte for each of its six varints and its digest
+static constexpr uint64_t BlockRecordVarints = 6;
+
+// version 2 and the headerless format store the md5 as 32 hex chars, versions before 4 store the local time as "%F %T",
+// versions before 6 have no flags, version 8 rows start with the directory id and hold the name instead of the path,
+// version 10 sizes the md5 from the header
+struct RecordLayout
+{
+	uint64_t Md5Len;
+	uint64_t TimeLen;
+	uint64_t FlagsLen;
+	uint64_t DirLen = 0;
+	bool Hex = false;
+
+	[[nodiscard]] uint64_t VLen() const { return Md5Len + SizeLen + TimeLen + FlagsLen; }
+};
+
+static constexpr RecordLayout HexLayout{ Md5HexLen, TimeTextLen, 0, 0, true };
+static constexpr RecordLayout TextTimeLayout{ Md5Len, TimeTextLen, 0 };
+static constexpr RecordLayout NoFlagsLayout{ Md5Len, TimeLen, 0 };
+static constexpr RecordLayout FlatLayout{ Md5Len, TimeLen, FlagsLen };
+static constexpr RecordLayout DirLayout{ Md5Len, TimeLen, FlagsLen, DirLen };
+
+static uint64_t ColumnSectionCount(const uint32_t version)
+{
+	return version >= 8 ? SectionCount : version >= 6 ? DirSection : FlagsSection;
+}
+
+struct Header
 {
-	remove(databasePath);
-	std::ofstream fs(databasePath, std::ios::binary | std::ios::out);
-	const auto fsBufSize = 1024 * 1024;
-	const auto fsBuf = std::make_unique<char[]>(fsBufSize);
-	fs.rdbuf()->pubsetbuf(fsBuf.get(), fsBufSize);
-	char nil[32]{ 0 };
-	for (const auto& [path,v] : fmd)
+	uint32_t Version;
+	uint32_t Flags;
+	uint64_t Count;
+	uint64_t IndexOffset;
+};
+
+template<typename T>
+static T LoadInt(const char* p)
+{
+	IntBytes<T> buf{};
+	memcpy(buf.bytes, p, sizeof(T));
+	if constexpr (Bit::Endian::Native != Bit::Endian::Little)
 	{
-		const auto& [md5, size, date] = v;
-		Uint64Bytes pathLen{ path.length() };
-		Uint64Bytes sizeStd{ size };
-		if constexpr (Bit::Endian::Native != Bit::Endian::Little)
+		buf.data = Bit::EndianSwap(buf.data);
+	}
+	return buf.data;
+}
+
+template<typename T>
+static void WriteInt(std::ofstream& fs, T value)
+{
+	IntBytes<T> buf{ value };
+	if constexpr (Bit::Endian::Native != Bit::Endian::Little)
+	{
+		buf.data = Bit::EndianSwap(buf.data);
+	}
+	fs.write(buf.bytes, sizeof(T));
+}
+
+template<typename T>
+static void AppendInt(std::string& out, T value)
+{
+	IntBytes<T> buf{ value };
+	if constexpr (Bit::Endian::Native != Bit::Endian::Little)
+	{
+		buf.data = Bit::EndianSwap(buf.data);
+	}
+	out.append(buf.bytes, sizeof(T));
+}
+
+static void AppendVarint(std::string& out, uint64_t value)
+{
+	for (; value >= 0x80; value >>= 7) out.push_back(static_cast<char>(value | 0x80));
+	out.push_back(static_cast<char>(value));
+}
+
+static bool ReadVarint(const char*& p, const char* end, uint64_t& value)
+{
+	value = 0;
+	for (uint32_t shift = 0; p != end && shift < 64; shift += 7)
+	{
+		const auto b = static_cast<uint8_t>(*p++);
+		value |= static_cast<uint64_t>(b & 0x7f) << shift;
+		if (!(b & 0x80)) return true;
+	}
+	return false;
+}
+
+// small deltas of either sign become small varints
+static uint64_t ZigZag(const int64_t value)
+{
+	return static_cast<uint64_t>(value) << 1 ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t UnZigZag(const uint64_t value)
+{
+	return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+static uint64_t HeaderMd5Len(const Header& header)
+{
+	return header.Version >= 10 ? header.Flags >> DigestLenShift & 0xffu : Md5Len;
+}
+
+static std::optional<Header> ReadHeader(const File::MemoryMap& map)
+{
+	if (map.Size() < HeaderLen || memcmp(map.Data(), Magic, sizeof Magic) != 0) return std::nullopt;
+	const Header header{ LoadInt<uint32_t>(map.Data() + 8), LoadInt<uint32_t>(map.Data() + 12), LoadInt<uint64_t>(map.Data() + 16), LoadInt<uint64_t>(map.Data() + 24) };
+	if (header.Version > Version) throw std::runtime_error("unsupported database version " + std::to_string(header.Version));
+	const auto md5Len = header.Flags >> DigestLenShift & 0xffu;
+	if ((header.Flags & ~(ColumnarFlag | BlocksFlag | AlgorithmMask | DigestLenMask)) != 0
+		|| (header.Flags & BlocksFlag && (header.Flags & ColumnarFlag || header.Version < 9))
+		|| (header.Flags >> AlgorithmShift & 0xffu) > static_cast<uint32_t>(HashAlgorithm::Xxh64)
+		|| (header.Version >= 10 ? md5Len == 0 || md5Len > Cryptography::Digest::MaxLen : md5Len != 0))
+	{
+		throw std::runtime_error("unsupported database flags " + std::to_string(header.Flags));
+	}
+	// records hold digests of the width of the process, see Md5Digest::Len
+	if (HeaderMd5Len(header) != Md5Digest::Len)
+	{
+		throw std::runtime_error("database stores " + std::to_string(HeaderMd5Len(header)) + " byte digests, " + std::to_string(Md5Digest::Len) + " expected");
+	}
+	const auto indexLen = header.Flags & ColumnarFlag ? ColumnSectionCount(header.Version) : header.Flags & BlocksFlag ? 1 : header.Count;
+	if (header.IndexOffset > map.Size() || (map.Size() - header.IndexOffset) / sizeof(uint64_t) < indexLen) throw std::runtime_error("database corrupted: bad index");
+	return header;
+}
+
+template<typename T>
+static const T* ColumnView(const char* p, const uint64_t count, std::vector<T>& owned)
+{
+	if constexpr (Bit::Endian::Native == Bit::Endian::Little)
+	{
+		return reinterpret_cast<const T*>(p);
+	}
+	else
+	{
+		owned.resize(count);
+		for (uint64_t i = 0; i < count; ++i) owned[i] = LoadInt<T>(p + i * sizeof(T));
+		return owned.data();
+	}
+}
+
+static uint64_t AlignSection(const uint64_t offset)
+{
+	return (offset + SectionAlign - 1) / SectionAlign * SectionAlign;
+}
+
+static void LoadTree(PathTree& tree, const char* data, const uint64_t size, const uint64_t offset)
+{
+	if (offset > size || reinterpret_cast<std::uintptr_t>(data + offset) % sizeof(uint64_t) != 0 || size - offset < sizeof(uint64_t)) throw std::runtime_error("database corrupted: bad directory table");
+	const auto count = LoadInt<uint64_t>(data + offset);
+	const auto offsetsBegin = offset + sizeof(uint64_t);
+	if (count == 0 || count > std::numeric_limits<uint32_t>::max()
+		|| (size - offsetsBegin) / (sizeof(uint64_t) + DirLen) < count
+		|| size - offsetsBegin - count * (sizeof(uint64_t) + DirLen) < sizeof(uint64_t))
+	{
+		throw std::runtime_error("database corrupted: bad directory table");
+	}
+	const auto parentsBegin = offsetsBegin + (count + 1) * sizeof(uint64_t);
+	const auto namesBegin = parentsBegin + count * DirLen;
+
+	tree.Count = count;
+	tree.NameOffsets = ColumnView(data + offsetsBegin, count + 1, tree.OwnedNameOffsets);
+	tree.Parents = ColumnView(data + parentsBegin, count, tree.OwnedParents);
+	tree.Names = data + namesBegin;
+	// directory 0 is the empty path, every other parent has a lower id, so rebuilding a path always ends
+	auto valid = tree.NameOffsets[0] == 0 && tree.NameOffsets[1] == 0 && tree.Parents[0] == 0
+		&& tree.NameOffsets[count] <= size - namesBegin && std::is_sorted(tree.NameOffsets, tree.NameOffsets + count + 1);
+	for (uint64_t i = 1; valid && i < count; ++i) valid = tree.Parents[i] < i;
+	if (!valid) throw std::runtime_error("database corrupted: bad directory table");
+}
+
+static void LoadColumns(ColumnStore& fmd, PathTree& tree, const File::MemoryMap& map, const Header& header)
+{
+	const auto* data = map.Data();
+	const auto size = map.Size();
+	const auto count = header.Count;
+	const auto sectionCount = ColumnSectionCount(header.Version);
+	const auto md5Len = HeaderMd5Len(header);
+	uint64_t sections[SectionCount]{};
+	for (uint64_t i = 0; i < sectionCount; ++i) sections[i] = LoadInt<uint64_t>(data + header.IndexOffset + i * sizeof(uint64_t));
+	const auto fits = [&](const ColumnSection section, const uint64_t width, const uint64_t n)
+	{
+		const auto offset = sections[section];
+		return offset <= size && offset % sizeof(uint64_t) == 0 && (size - offset) / width >= n;
+	};
+	if (count == std::numeric_limits<uint64_t>::max()
+		|| !fits(PathOffsetsSection, sizeof(uint64_t), count + 1)
+		|| !fits(Md5Section, md5Len, count)
+		|| !fits(SizeSection, SizeLen, count)
+		|| !fits(TimeSection, TimeLen, count)
+		|| (sectionCount > FlagsSection && !fits(FlagsSection, FlagsLen, count))
+		|| (sectionCount > DirSection && !fits(DirSection, DirLen, count))
+		|| sections[PathsSection] > size)
+	{
+		throw std::runtime_error("database corrupted: bad section");
+	}
+
+	fmd.Count = count;
+	fmd.PathOffsets = ColumnView(data + sections[PathOffsetsSection], count + 1, fmd.OwnedPathOffsets);
+	fmd.Paths = data + sections[PathsSection];
+	fmd.Md5 = reinterpret_cast<const uint8_t*>(data + sections[Md5Section]);
+	fmd.Md5Len = md5Len;
+	fmd.Size = ColumnView(data + sections[SizeSection], count, fmd.OwnedSize);
+	fmd.Time = ColumnView(data + sections[TimeSection], count, fmd.OwnedTime);
+	fmd.Flags = sectionCount > FlagsSection ? ColumnView(data + sections[FlagsSection], count, fmd.OwnedFlags) : nullptr;
+	if (fmd.PathOffsets[0] != 0 || fmd.PathOffsets[count] > size - sections[PathsSection] || !std::is_sorted(std::execution::par_unseq, fmd.PathOffsets, fmd.PathOffsets + count + 1))
+	{
+		throw std::runtime_error("database corrupted: bad path offsets");
+	}
+	if (sectionCount > DirSection)
+	{
+		LoadTree(tree, data, size, sections[TreeSection]);
+		fmd.Dirs = ColumnView(data + sections[DirSection], count, fmd.OwnedDirs);
+		fmd.Tree = &tree;
+		if (!std::all_of(std::execution::par_unseq, fmd.Dirs, fmd.Dirs + count, [&](const uint32_t dir) { return dir < tree.Count; }))
 		{
-			pathLen.data = Bit::EndianSwap(pathLen.data);
-			sizeStd.data = Bit::EndianSwap(sizeStd.data);
+			throw std::runtime_error("database corrupted: bad directory");
 		}
-		fs.write(pathLen.bytes, sizeof(Uint64Bytes));
-		fs << path;
-		fs.write(md5.empty() ? nil : md5.c_str(), 32);
-		fs.write(sizeStd.bytes, sizeof(Uint64Bytes));
-		fs.write(date.empty() ? nil : date.c_str(), 19);
 	}
-	fs.close();
 }
 
-static char NilStrData[] = "";
-static const StrPtr NilStr{ NilStrData, 0 };
+struct Block
+{
+	uint32_t RawLen;
+	uint32_t StoredLen;
+	uint32_t Count;
+	uint32_t Flags;
+};
+
+static Block ReadBlock(const File::MemoryMap& map, const uint64_t offset)
+{
+	if (offset > map.Size() || map.Size() - offset < BlockHeaderLen) throw std::runtime_error("database corrupted: bad block");
+	const auto* p = map.Data() + offset;
+	const Block block{ LoadInt<uint32_t>(p), LoadInt<uint32_t>(p + 4), LoadInt<uint32_t>(p + 8), LoadInt<uint32_t>(p + 12) };
+	if ((block.Flags & ~BlockCompressed) != 0 || map.Size() - offset - BlockHeaderLen < block.StoredLen
+		|| (!(block.Flags & BlockCompressed) && block.StoredLen != block.RawLen))
+	{
+		throw std::runtime_error("database corrupted: bad block");
+	}
+	return block;
+}
+
+// the data of a block, decompressed into owned unless it is stored as is
+static std::optional<std::string_view> BlockData(const File::MemoryMap& map, const uint64_t offset, const Block& block, std::unique_ptr<char[]>& owned)
+{
+	const auto* stored = map.Data() + offset + BlockHeaderLen;
+	if (!(block.Flags & BlockCompressed)) return std::string_view(stored, block.StoredLen);
+	owned = std::make_unique<char[]>(block.RawLen);
+	if (!Lz::Decompress(stored, block.StoredLen, owned.get(), block.RawLen)) return std::nullopt;
+	return std::string_view(owned.get(), block.RawLen);
+}
+
+// see AppendRecordBlock, the names are measured first so that they are rebuilt into a single buffer, which also keeps
+// the digests that do not fit in a record, a block stored as is in the mapping is referenced wherever it holds a whole
+// name or digest
+static bool DecodeRecordBlock(const std::string_view raw, const bool mapped, const uint64_t count, const uint64_t md5Len, const PathTree& tree, ModelRef* models,
+	std::unique_ptr<char[]>& names)
+{
+	const auto* p = raw.data();
+	const auto* const end = p + raw.length();
+	uint64_t value = 0;
+	// deltas wrap around in unsigned arithmetic, a corrupted one lands outside the directory table instead of overflowing
+	uint64_t dir = 0;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		if (!ReadVarint(p, end, value)) return false;
+		dir += static_cast<uint64_t>(UnZigZag(value));
+		if (dir >= tree.Count) return false;
+		models[i].Tree = &tree;
+		models[i].Dir = static_cast<uint32_t>(dir);
+	}
+
+	const auto* namesBegin = p;
+	uint64_t namesLen = 0;
+	uint64_t previousLen = 0;
+	uint64_t shared = 0;
+	uint64_t suffixLen = 0;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		if (!ReadVarint(p, end, shared) || !ReadVarint(p, end, suffixLen) || shared > previousLen || static_cast<uint64_t>(end - p) < suffixLen) return false;
+		p += suffixLen;
+		previousLen = shared + suffixLen;
+		if (shared != 0 || !mapped) namesLen += previousLen;
+	}
+	const auto wide = md5Len > Md5Digest::InlineLen;
+	const auto owned = wide && !mapped;
+	names = std::make_unique<char[]>(namesLen + (owned ? count * md5Len : 0));
+	auto* name = names.get();
+	const char* previous = name;
+	p = namesBegin;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		ReadVarint(p, end, shared);
+		ReadVarint(p, end, suffixLen);
+		if (shared == 0 && mapped)
+		{
+			models[i].Name = std::string_view(p, suffixLen);
+		}
+		else
+		{
+			memcpy(name, previous, shared);
+			memcpy(name + shared, p, suffixLen);
+			models[i].Name = std::string_view(name, shared + suffixLen);
+			name += shared + suffixLen;
+		}
+		previous = models[i].Name.data();
+		p += suffixLen;
+	}
+
+	if (static_cast<uint64_t>(end - p) / md5Len < count) return false;
+	const auto* md5s = owned ? static_cast<const char*>(memcpy(name, p, count * md5Len)) : p;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		const auto* md5 = reinterpret_cast<const uint8_t*>(md5s + i * md5Len);
+		models[i].Md5 = wide ? Md5Digest::View(md5) : Md5Digest(md5, md5Len);
+	}
+	p += count * md5Len;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		if (!ReadVarint(p, end, value)) return false;
+		models[i].Size = value;
+	}
+	uint64_t time = 0;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		if (!ReadVarint(p, end, value)) return false;
+		time += static_cast<uint64_t>(UnZigZag(value));
+		models[i].Time = Timestamp{ static_cast<int64_t>(time) };
+	}
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		if (!ReadVarint(p, end, value) || value > std::numeric_limits<uint32_t>::max()) return false;
+		models[i].Flags = static_cast<uint32_t>(value);
+	}
+	return p == end;
+}
+
+// the block headers are read in order to place every block, then the blocks decode in parallel
+static void LoadBlocks(std::vector<ModelRef>& fmd, PathTree& tree, const File::MemoryMap& map, const Header& header)
+{
+	const auto indexLen = map.Size() - header.IndexOffset;
+	if (indexLen % sizeof(uint64_t) != 0) throw std::runtime_error("database corrupted: bad index");
+	const auto blockCount = indexLen / sizeof(uint64_t);
+	const auto md5Len = HeaderMd5Len(header);
+	std::vector<uint64_t> offsets(blockCount);
+	std::vector<Block> blocks(blockCount);
+	std::vector<uint64_t> firsts(blockCount);
+	uint64_t count = 0;
+	for (uint64_t i = 0; i < blockCount; ++i)
+	{
+		offsets[i] = LoadInt<uint64_t>(map.Data() + header.IndexOffset + i * sizeof(uint64_t));
+		blocks[i] = ReadBlock(map, offsets[i]);
+		// checked before the records are allocated
+		if (blocks[i].Count > BlockRecords || blocks[i].Count > blocks[i].RawLen / (BlockRecordVarints + md5Len)) throw std::runtime_error("database corrupted: bad block");
+		firsts[i] = count;
+		count += blocks[i].Count;
+	}
+	if (blocks[0].Count != 0 || count != header.Count) throw std::runtime_error("database corrupted: bad block");
+
+	tree.OwnedBlocks.resize(blockCount);
+	const auto table = BlockData(map, offsets[0], blocks[0], tree.OwnedBlocks[0]);
+	if (!table) throw std::runtime_error("database corrupted: bad block");
+	LoadTree(tree, table->data(), table->length(), 0);
+
+	const auto base = fmd.size();
+	fmd.resize(base + count);
+	std::atomic<bool> corrupted = false;
+	std::for_each(std::execution::par, blocks.begin() + 1, blocks.end(), [&](const Block& block)
+	{
+		const auto i = static_cast<uint64_t>(&block - blocks.data());
+		std::unique_ptr<char[]> owned{};
+		const auto raw = BlockData(map, offsets[i], block, owned);
+		const auto mapped = !(block.Flags & BlockCompressed);
+		if (!raw || !DecodeRecordBlock(*raw, mapped, block.Count, md5Len, tree, fmd.data() + base + firsts[i], tree.OwnedBlocks[i])) corrupted = true;
+	});
+	if (corrupted) throw std::runtime_error("database corrupted: bad block");
+}
+
+static bool ParseRecord(const File::MemoryMap& map, const RecordLayout& layout, const uint64_t offset, ModelRef& model, uint64_t& next)
+{
+	const auto* data = map.Data();
+	const auto size = map.Size();
+	const auto vLen = layout.VLen();
+	if (offset > size || size - offset < layout.DirLen + sizeof(uint64_t)) return false;
+	const auto pathLen = LoadInt<uint64_t>(data + offset + layout.DirLen);
+	const auto begin = offset + layout.DirLen + sizeof(uint64_t);
+	if (size - begin < vLen || size - begin - vLen < pathLen) return false;
+
+	const auto* md5Begin = data + begin + pathLen;
+	const auto* timeBegin = md5Begin + layout.Md5Len + SizeLen;
+	model.Dir = layout.DirLen ? LoadInt<uint32_t>(data + offset) : 0;
+	model.Name = std::string_view(data + begin, pathLen);
+	model.Md5 = {};
+	if (!layout.Hex)
+	{
+		model.Md5 = Md5Digest::View(reinterpret_cast<const uint8_t*>(md5Begin));
+	}
+	else if (Cryptography::Md5::DigestData md5{}; *md5Begin != 0)
+	{
+		if (!Cryptography::Md5::FromHex(std::string_view(md5Begin, layout.Md5Len), md5)) return false;
+		model.Md5 = Md5Digest(md5.Word, Md5Len);
+	}
+	model.Size = LoadInt<uint64_t>(md5Begin + layout.Md5Len);
+	if (layout.TimeLen == TimeLen)
+	{
+		model.Time = Timestamp{ LoadInt<int64_t>(timeBegin) };
+	}
+	else
+	{
+		model.Time = *timeBegin == 0 ? Timestamp{} : ParseLocalTime(std::string_view(timeBegin, layout.TimeLen)).value_or(Timestamp{});
+	}
+	model.Flags = layout.FlagsLen ? LoadInt<uint32_t>(timeBegin + layout.TimeLen) : 0;
+	next = begin + pathLen + vLen;
+	return true;
+}
+
+static void WriteHeader(std::ofstream& fs, const uint32_t flags, const uint64_t count, const uint64_t indexOffset)
+{
+	fs.write(Magic, sizeof Magic);
+	WriteInt<uint32_t>(fs, Version);
+	WriteInt<uint32_t>(fs, flags);
+	WriteInt<uint64_t>(fs, count);
+	WriteInt<uint64_t>(fs, indexOffset);
+}
+
+static void WritePadding(std::ofstream& fs, uint64_t& offset, const uint64_t target)
+{
+	static constexpr char zeros[SectionAlign]{};
+	fs.write(zeros, static_cast<std::streamsize>(target - offset));
+	offset = target;
+}
+
+// the directories of records in path order
+struct TreeTable
+{
+	// the directory paths in id order, the parent of each and the directory of every record
+	std::vector<std::string_view> Paths{};
+	std::vector<uint32_t> Parents{};
+	std::vector<uint32_t> Dirs{};
+	uint64_t NamesLen = 0;
+	uint64_t RecordNamesLen = 0;
+
+	[[nodiscard]] uint64_t Len() const { return sizeof(uint64_t) + (Paths.size() + 1) * sizeof(uint64_t) + Paths.size() * DirLen + NamesLen; }
+};
+
+// everything up to and including the last separator
+static std::string_view DirectoryOf(const std::string_view path)
+{
+	const auto split = path.find_last_of(PathTree::Separators);
+	return path.substr(0, split == std::string_view::npos ? 0 : split + 1);
+}
+
+static std::string_view ParentOf(const std::string_view dir)
+{
+	return DirectoryOf(dir.substr(0, dir.length() - 1));
+}
+
+// records in path order enter every directory once, right after its parent and in path order, so directories are
+// numbered as they are entered while the ones still open are kept on a stack
+static TreeTable BuildTree(const std::vector<const Database::Record*>& records)
+{
+	TreeTable tree{};
+	tree.Paths.emplace_back();
+	tree.Parents.push_back(0);
+	tree.Dirs.resize(records.size());
+	std::vector<uint32_t> open{ 0 };
+	std::vector<std::string_view> entered{};
+	for (std::size_t i = 0; i < records.size(); ++i)
+	{
+		const auto& path = records[i]->first;
+		const auto dir = DirectoryOf(path);
+		if (dir != tree.Paths[open.back()])
+		{
+			while (dir.substr(0, tree.Paths[open.back()].length()) != tree.Paths[open.back()]) open.pop_back();
+			for (auto d = dir; d.length() > tree.Paths[open.back()].length(); d = ParentOf(d)) entered.push_back(d);
+			if (tree.Paths.size() + entered.size() > std::numeric_limits<uint32_t>::max()) throw std::runtime_error("too many directories");
+			for (auto d = entered.rbegin(); d != entered.rend(); ++d)
+			{
+				tree.NamesLen += d->length() - tree.Paths[open.back()].length();
+				tree.Parents.push_back(open.back());
+				open.push_back(static_cast<uint32_t>(tree.Paths.size()));
+				tree.Paths.push_back(*d);
+			}
+			entered.clear();
+		}
+		tree.Dirs[i] = open.back();
+		tree.RecordNamesLen += path.length() - dir.length();
+	}
+	return tree;
+}
+
+static void WriteTree(std::ofstream& fs, const TreeTable& tree)
+{
+	WriteInt<uint64_t>(fs, tree.Paths.size());
+	uint64_t nameOffset = 0;
+	WriteInt<uint64_t>(fs, nameOffset);
+	for (std::size_t i = 0; i < tree.Paths.size(); ++i)
+	{
+		nameOffset += tree.Paths[i].length() - tree.Paths[tree.Parents[i]].length();
+		WriteInt<uint64_t>(fs, nameOffset);
+	}
+	for (const auto parent : tree.Parents)
+	{
+		WriteInt<uint32_t>(fs, parent);
+	}
+	for (std::size_t i = 0; i < tree.Paths.size(); ++i)
+	{
+		fs << tree.Paths[i].substr(tree.Paths[tree.Parents[i]].length());
+	}
+}
+
+// the same table in memory, to be stored as a block
+static void AppendTree(std::string& out, const TreeTable& tree)
+{
+	out.reserve(out.length() + tree.Len());
+	AppendInt<uint64_t>(out, tree.Paths.size());
+	uint64_t nameOffset = 0;
+	AppendInt<uint64_t>(out, nameOffset);
+	for (std::size_t i = 0; i < tree.Paths.size(); ++i)
+	{
+		nameOffset += tree.Paths[i].length() - tree.Paths[tree.Parents[i]].length();
+		AppendInt<uint64_t>(out, nameOffset);
+	}
+	for (const auto parent : tree.Parents)
+	{
+		AppendInt<uint32_t>(out, parent);
+	}
+	for (std::size_t i = 0; i < tree.Paths.size(); ++i)
+	{
+		out.append(tree.Paths[i].substr(tree.Paths[tree.Parents[i]].length()));
+	}
+}
+
+static void SerializationRow(const Database& fmd, std::ofstream& fs, const uint32_t flags, const uint64_t md5Len)
+{
+	auto layout = DirLayout;
+	layout.Md5Len = md5Len;
+	WriteHeader(fs, flags, 0, 0);
+	const auto records = fmd.Ordered();
+	const auto tree = BuildTree(records);
+	std::vector<uint64_t> index{};
+	index.reserve(records.size());
+	uint64_t offset = HeaderLen;
+	for (std::size_t i = 0; i < records.size(); ++i)
+	{
+		const auto& [path, v] = *records[i];
+		const auto& [md5, size, date, recordFlags] = v;
+		const auto name = path.substr(tree.Paths[tree.Dirs[i]].length());
+		index.push_back(offset);
+		WriteInt<uint32_t>(fs, tree.Dirs[i]);
+		WriteInt<uint64_t>(fs, name.length());
+		fs << name;
+		fs.write(reinterpret_cast<const char*>(md5.Data()), static_cast<std::streamsize>(md5Len));
+		WriteInt<uint64_t>(fs, size);
+		WriteInt<int64_t>(fs, date.Value);
+		WriteInt<uint32_t>(fs, recordFlags);
+		offset += DirLen + sizeof(uint64_t) + name.length() + layout.VLen();
+	}
+	const auto indexOffset = offset;
+	for (const auto i : index)
+	{
+		WriteInt<uint64_t>(fs, i);
+	}
+	offset += index.size() * sizeof(uint64_t);
+	WritePadding(fs, offset, AlignSection(offset));
+	WriteTree(fs, tree);
+
+	fs.seekp(16);
+	WriteInt<uint64_t>(fs, index.size());
+	WriteInt<uint64_t>(fs, indexOffset);
+}
+
+static void SerializationColumnar(const Database& fmd, std::ofstream& fs, const uint32_t flags, const uint64_t md5Len)
+{
+	const uint64_t count = fmd.size();
+	const auto records = fmd.Ordered();
+	const auto tree = BuildTree(records);
+	uint64_t sections[SectionCount]{};
+	sections[PathOffsetsSection] = AlignSection(HeaderLen + sizeof sections);
+	sections[Md5Section] = AlignSection(sections[PathOffsetsSection] + (count + 1) * sizeof(uint64_t));
+	sections[SizeSection] = AlignSection(sections[Md5Section] + count * md5Len);
+	sections[TimeSection] = AlignSection(sections[SizeSection] + count * SizeLen);
+	sections[FlagsSection] = AlignSection(sections[TimeSection] + count * TimeLen);
+	sections[DirSection] = AlignSection(sections[FlagsSection] + count * FlagsLen);
+	sections[PathsSection] = AlignSection(sections[DirSection] + count * DirLen);
+	sections[TreeSection] = AlignSection(sections[PathsSection] + tree.RecordNamesLen);
+
+	WriteHeader(fs, flags | ColumnarFlag, count, HeaderLen);
+	for (const auto section : sections)
+	{
+		WriteInt<uint64_t>(fs, section);
+	}
+	uint64_t offset = HeaderLen + sizeof sections;
+	const auto name = [&](const std::size_t i) { return records[i]->first.substr(tree.Paths[tree.Dirs[i]].length()); };
+
+	WritePadding(fs, offset, sections[PathOffsetsSection]);
+	uint64_t pathOffset = 0;
+	WriteInt<uint64_t>(fs, pathOffset);
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		pathOffset += name(i).length();
+		WriteInt<uint64_t>(fs, pathOffset);
+	}
+	offset += (count + 1) * sizeof(uint64_t);
+
+	WritePadding(fs, offset, sections[Md5Section]);
+	for (const auto* record : records)
+	{
+		fs.write(reinterpret_cast<const char*>(std::get<0>(record->second).Data()), static_cast<std::streamsize>(md5Len));
+	}
+	offset += count * md5Len;
+
+	WritePadding(fs, offset, sections[SizeSection]);
+	for (const auto* record : records)
+	{
+		WriteInt<uint64_t>(fs, std::get<1>(record->second));
+	}
+	offset += count * SizeLen;
+
+	WritePadding(fs, offset, sections[TimeSection]);
+	for (const auto* record : records)
+	{
+		WriteInt<int64_t>(fs, std::get<2>(record->second).Value);
+	}
+	offset += count * TimeLen;
+
+	WritePadding(fs, offset, sections[FlagsSection]);
+	for (const auto* record : records)
+	{
+		WriteInt<uint32_t>(fs, std::get<3>(record->second));
+	}
+	offset += count * FlagsLen;
+
+	WritePadding(fs, offset, sections[DirSection]);
+	for (const auto dir : tree.Dirs)
+	{
+		WriteInt<uint32_t>(fs, dir);
+	}
+	offset += count * DirLen;
+
+	WritePadding(fs, offset, sections[PathsSection]);
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		fs << name(i);
+	}
+	offset += tree.RecordNamesLen;
+
+	WritePadding(fs, offset, sections[TreeSection]);
+	WriteTree(fs, tree);
+}
+
+// header and data of a block, stored as is when compressing does not make it smaller
+static void AppendBlock(std::string& out, const std::string& raw, const uint64_t count)
+{
+	if (raw.length() > std::numeric_limits<uint32_t>::max()) throw std::runtime_error("block too large");
+	std::string packed(Lz::Bound(raw.length()), '\0');
+	const auto packedLen = Lz::Compress(raw.data(), raw.length(), packed.data());
+	const auto compressed = packedLen < raw.length();
+	const auto& stored = compressed ? packed : raw;
+	const auto storedLen = compressed ? packedLen : raw.length();
+	AppendInt<uint32_t>(out, static_cast<uint32_t>(raw.length()));
+	AppendInt<uint32_t>(out, static_cast<uint32_t>(storedLen));
+	AppendInt<uint32_t>(out, static_cast<uint32_t>(count));
+	AppendInt<uint32_t>(out, compressed ? BlockCompressed : 0);
+	out.append(stored.data(), storedLen);
+}
 
-#define NullOr(q,o,v) ((q) ? (o) : (v))
+// records [begin, end) column by column: directory ids as zigzag varint deltas, names front-coded as
+// [varint length shared with the previous name][varint suffix length][suffix], md5s, varint sizes,
+// times as zigzag varint deltas and varint flags
+static void AppendRecordBlock(std::string& out, const std::vector<const Database::Record*>& records, const TreeTable& tree, const uint64_t md5Len, const uint64_t begin, const uint64_t end)
+{
+	std::string raw{};
+	int64_t dir = 0;
+	for (auto i = begin; i < end; ++i)
+	{
+		AppendVarint(raw, ZigZag(tree.Dirs[i] - dir));
+		dir = tree.Dirs[i];
+	}
+	std::string_view previous{};
+	for (auto i = begin; i < end; ++i)
+	{
+		const auto name = records[i]->first.substr(tree.Paths[tree.Dirs[i]].length());
+		const auto shared = static_cast<uint64_t>(std::mismatch(previous.begin(), previous.end(), name.begin(), name.end()).first - previous.begin());
+		AppendVarint(raw, shared);
+		AppendVarint(raw, name.length() - shared);
+		raw.append(name.substr(shared));
+		previous = name;
+	}
+	for (auto i = begin; i < end; ++i)
+	{
+		raw.append(reinterpret_cast<const char*>(std::get<0>(records[i]->second).Data()), md5Len);
+	}
+	for (auto i = begin; i < end; ++i)
+	{
+		AppendVarint(raw, std::get<1>(records[i]->second));
+	}
+	uint64_t time = 0;
+	for (auto i = begin; i < end; ++i)
+	{
+		const auto current = static_cast<uint64_t>(std::get<2>(records[i]->second).Value);
+		AppendVarint(raw, ZigZag(static_cast<int64_t>(current - time)));
+		time = current;
+	}
+	for (auto i = begin; i < end; ++i)
+	{
+		AppendVarint(raw, std::get<3>(records[i]->second));
+	}
+	AppendBlock(out, raw, end - begin);
+}
 
-template<typename T = Database>
-void DeserializationImpl(T& fmd, const std::filesystem::path& databasePath)
+// blocks follow the header, the directory table first so its data stays aligned when stored as is, and their offsets
+// fill the file from IndexOffset on, batches of record blocks are encoded in parallel and written in order
+static void SerializationBlocks(const Database& fmd, std::ofstream& fs, const uint32_t flags, const uint64_t md5Len)
+{
+	const auto records = fmd.Ordered();
+	const auto tree = BuildTree(records);
+	WriteHeader(fs, flags | BlocksFlag, records.size(), 0);
+	std::vector<uint64_t> index{};
+	uint64_t offset = HeaderLen;
+	const auto write = [&](const std::string& block)
+	{
+		index.push_back(offset);
+		fs << block;
+		offset += block.length();
+	};
+	{
+		std::string table{};
+		AppendTree(table, tree);
+		std::string block{};
+		AppendBlock(block, table, 0);
+		write(block);
+	}
+
+	const auto blockCount = (records.size() + BlockRecords - 1) / BlockRecords;
+	std::vector<std::string> batch(std::min(blockCount, BlockBatch));
+	for (uint64_t first = 0; first < blockCount; first += batch.size())
+	{
+		const auto n = std::min<uint64_t>(batch.size(), blockCount - first);
+		std::for_each(std::execution::par, batch.begin(), batch.begin() + n, [&](std::string& block)
+		{
+			const auto b = first + static_cast<uint64_t>(&block - batch.data());
+			block.clear();
+			AppendRecordBlock(block, records, tree, md5Len, b * BlockRecords, std::min<uint64_t>((b + 1) * BlockRecords, records.size()));
+		});
+		for (uint64_t i = 0; i < n; ++i) write(batch[i]);
+	}
+	const auto indexOffset = offset;
+	for (const auto i : index)
+	{
+		WriteInt<uint64_t>(fs, i);
+	}
+
+	fs.seekp(24);
+	WriteInt<uint64_t>(fs, indexOffset);
+}
+
+// writes next to path and renames over it once the data is on disk, then syncs the directory so the rename is durable too,
+// a crash leaves either the old or the new file
+template<typename Func>
+static void WriteAtomic(const std::filesystem::path& path, Func&& func)
+{
+	auto tmpPath = path;
+	tmpPath += ".tmp";
+	{
+		std::ofstream fs(tmpPath, std::ios::binary | std::ios::out | std::ios::trunc);
+		const auto fsBufSize = 1024 * 1024;
+		const auto fsBuf = std::make_unique<char[]>(fsBufSize);
+		fs.rdbuf()->pubsetbuf(fsBuf.get(), fsBufSize);
+		func(fs);
+		fs.close();
+		if (!fs) throw std::runtime_error("write error: " + tmpPath.u8string());
+	}
+	File::Sync(tmpPath);
+	rename(tmpPath, path);
+	File::SyncDirectory(path.parent_path());
+}
+
+void Serialization(const Database& fmd, const std::filesystem::path& databasePath, const StorageLayout layout, const HashAlgorithm algorithm)
+{
+	const auto md5Len = Md5Digest::Len;
+	if (md5Len == 0 || md5Len > Cryptography::Digest::MaxLen) throw std::runtime_error("invalid digest length " + std::to_string(md5Len));
+	// fmd is complete, including what was replayed from the log
+	const auto flags = static_cast<uint32_t>(algorithm) << AlgorithmShift | static_cast<uint32_t>(md5Len) << DigestLenShift;
+	WriteAtomic(databasePath, [&](std::ofstream& fs)
+	{
+		if (layout == StorageLayout::Columnar) SerializationColumnar(fmd, fs, flags, md5Len);
+		else if (layout == StorageLayout::Block) SerializationBlocks(fmd, fs, flags, md5Len);
+		else SerializationRow(fmd, fs, flags, md5Len);
+	});
+	std::error_code ec{};
+	remove(LogPath(databasePath), ec);
+}
+
+StorageLayout DatabaseLayout(const std::filesystem::path& databasePath)
 {
 	std::ifstream fs(databasePath, std::ios::binary | std::ios::in);
-	const auto fsBufSize = 1024 * 1024;
-	const auto fsBuf = std::make_unique<char[]>(fsBufSize);
-	fs.rdbuf()->pubsetbuf(fsBuf.get(), fsBufSize);
-	Uint64Bytes uint64Buf{ 0 };
-	constexpr auto md5Len = 32;
-	constexpr auto sizeLen = 8;
-	constexpr auto timeLen = 19;
-	constexpr auto vLen = md5Len + sizeLen + timeLen;
-
-	char* buf = nullptr;
-	
-	if constexpr (std::is_same<T, Database>::value)
-	{
-		buf = new char[65536];
-		memset(buf, 0, 65536);
-	}
-	while (true)
-	{
-		fs.read(uint64Buf.bytes, sizeof(Uint64Bytes));
-		if (fs.eof()) { break; }
-		if constexpr (Bit::Endian::Native != Bit::Endian::Little)
+	char header[16]{};
+	if (!fs.read(header, sizeof header) || memcmp(header, Magic, sizeof Magic) != 0) return StorageLayout::Row;
+	const auto flags = LoadInt<uint32_t>(header + 12);
+	return flags & ColumnarFlag ? StorageLayout::Columnar : flags & BlocksFlag ? StorageLayout::Block : StorageLayout::Row;
+}
+
+HashAlgorithm DatabaseAlgorithm(const std::filesystem::path& databasePath)
+{
+	std::ifstream fs(databasePath, std::ios::binary | std::ios::in);
+	char header[16]{};
+	if (!fs.read(header, sizeof header) || memcmp(header, Magic, sizeof Magic) != 0) return HashAlgorithm::Md5;
+	return static_cast<HashAlgorithm>(LoadInt<uint32_t>(header + 12) >> AlgorithmShift & 0xffu);
+}
+
+uint64_t DatabaseDigestLen(const std::filesystem::path& databasePath, const HashAlgorithm algorithm)
+{
+	std::ifstream fs(databasePath, std::ios::binary | std::ios::in);
+	char header[16]{};
+	if (!fs.read(header, sizeof header)) return DigestLen(algorithm);
+	if (memcmp(header, Magic, sizeof Magic) != 0 || LoadInt<uint32_t>(header + 8) < 10) return Md5Len;
+	return LoadInt<uint32_t>(header + 12) >> DigestLenShift & 0xffu;
+}
+
+void Deserialization(Database& fmd, const std::filesystem::path& databasePath)
+{
+	const File::MemoryMap map(databasePath);
+	std::vector<ModelRef> models{};
+	PathTree tree{};
+	DeserializationAsModel(models, tree, map);
+	Database log{};
+	ReplayLog(log, databasePath);
+	fmd.reserve(fmd.size() + models.size() + log.size());
+	// records come in path order, so the directory path is rebuilt only when it changes
+	std::string path{};
+	std::size_t dirLen = 0;
+	std::optional<uint32_t> dir{};
+	for (const auto& model : models)
+	{
+		if (model.Tree && dir != model.Dir)
 		{
-			uint64Buf.data = Bit::EndianSwap(uint64Buf.data);
+			path.clear();
+			tree.AppendPath(path, model.Dir);
+			dirLen = path.length();
+			dir = model.Dir;
 		}
-		const auto pathLen = uint64Buf.data;
-		const auto totalLen = pathLen + vLen;
-		if constexpr (std::is_same<T, std::vector<Model>>::value)
+		path.resize(model.Tree ? dirLen : 0);
+		path.append(model.Name);
+		if (log.find(path) != log.end()) continue;
+		fmd.emplace(path, std::make_tuple(model.Md5.Owned(), model.Size, model.Time, model.Flags));
+	}
+	fmd.merge(log);
+}
+
+void DeserializationAsModel(std::vector<ModelRef>& fmd, PathTree& tree, const File::MemoryMap& map)
+{
+	if (const auto header = ReadHeader(map))
+	{
+		if (header->Flags & ColumnarFlag)
 		{
-			buf = new char[totalLen];
+			ColumnStore columns{};
+			LoadColumns(columns, tree, map, *header);
+			const auto base = fmd.size();
+			fmd.resize(base + columns.Count);
+			std::for_each(std::execution::par_unseq, fmd.begin() + base, fmd.end(), [&](ModelRef& model)
+			{
+				model = columns.At(static_cast<uint64_t>(&model - fmd.data()) - base);
+			});
+			return;
 		}
-		fs.read(buf, totalLen);
-		memcpy(uint64Buf.bytes, buf + pathLen + md5Len, sizeof(Uint64Bytes));
+		if (header->Flags & BlocksFlag)
+		{
+			LoadBlocks(fmd, tree, map, *header);
+			return;
+		}
+		auto layout = header->Version >= 8 ? DirLayout : header->Version >= 6 ? FlatLayout : header->Version >= 4 ? NoFlagsLayout : header->Version == 3 ? TextTimeLayout : HexLayout;
+		if (header->Version >= 10) layout.Md5Len = HeaderMd5Len(*header);
+		const auto* index = map.Data() + header->IndexOffset;
+		if (layout.DirLen) LoadTree(tree, map.Data(), map.Size(), AlignSection(header->IndexOffset + header->Count * sizeof(uint64_t)));
+		const auto base = fmd.size();
+		fmd.resize(base + header->Count);
+		std::atomic<bool> corrupted = false;
+		std::for_each(std::execution::par, fmd.begin() + base, fmd.end(), [&](ModelRef& model)
+		{
+			const auto i = static_cast<uint64_t>(&model - fmd.data()) - base;
+			uint64_t next = 0;
+			if (!ParseRecord(map, layout, LoadInt<uint64_t>(index + i * sizeof(uint64_t)), model, next)) corrupted = true;
+			if (layout.DirLen)
+			{
+				model.Tree = &tree;
+				if (model.Dir >= tree.Count) corrupted = true;
+			}
+		});
+		if (corrupted) throw std::runtime_error("database corrupted: bad record");
+		return;
+	}
+
+	uint64_t offset = 0;
+	while (offset < map.Size())
+	{
+		ModelRef model{};
+		if (!ParseRecord(map, HexLayout, offset, model, offset)) throw std::runtime_error("database corrupted: bad record");
+		fmd.push_back(model);
+	}
+}
+
+bool DeserializationAsColumns(ColumnStore& fmd, PathTree& tree, const File::MemoryMap& map)
+{
+	const auto header = ReadHeader(map);
+	if (!header || !(header->Flags & ColumnarFlag)) return false;
+	LoadColumns(fmd, tree, map, *header);
+	return true;
+}
+
+static uint32_t Crc32(const char* data, const uint64_t len)
+{
+	static const auto table = []()
+	{
+		std::array<uint32_t, 256> res{};
+		for (uint32_t i = 0; i < 256; ++i)
+		{
+			auto c = i;
+			for (auto k = 0; k < 8; ++k) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			res[i] = c;
+		}
+		return res;
+	}();
+	uint32_t crc = 0xffffffffu;
+	for (uint64_t i = 0; i < len; ++i) crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xff] ^ (crc >> 8);
+	return crc ^ 0xffffffffu;
+}
+
+static uint64_t LogMd5Len(const File::MemoryMap& map)
+{
+	return LoadInt<uint32_t>(map.Data() + 8) >= 3 ? LoadInt<uint32_t>(map.Data() + 12) : Md5Len;
+}
+
+// calls func for every intact entry and returns the offset just past the last one
+template<typename Func>
+static uint64_t ScanLog(const File::MemoryMap& map, Func&& func)
+{
+	if (map.Size() < LogHeaderLen || memcmp(map.Data(), LogMagic, sizeof LogMagic) != 0) throw std::runtime_error("database log corrupted: bad header");
+	const auto logVersion = LoadInt<uint32_t>(map.Data() + 8);
+	if (logVersion > LogVersion) throw std::runtime_error("unsupported database log version " + std::to_string(logVersion));
+	auto layout = logVersion >= 2 ? FlatLayout : NoFlagsLayout;
+	layout.Md5Len = LogMd5Len(map);
+	if (layout.Md5Len != Md5Digest::Len)
+	{
+		throw std::runtime_error("database log stores " + std::to_string(layout.Md5Len) + " byte digests, " + std::to_string(Md5Digest::Len) + " expected");
+	}
+	uint64_t offset = LogHeaderLen;
+	ModelRef model{};
+	uint64_t next = 0;
+	while (ParseRecord(map, layout, offset, model, next)
+		&& map.Size() - next >= LogCrcLen
+		&& LoadInt<uint32_t>(map.Data() + next) == Crc32(map.Data() + offset, next - offset))
+	{
+		func(model);
+		offset = next + LogCrcLen;
+	}
+	return offset;
+}
+
+std::filesystem::path LogPath(const std::filesystem::path& databasePath)
+{
+	auto path = databasePath;
+	path += ".wal";
+	return path;
+}
+
+static void WriteLogHeader(std::ofstream& fs)
+{
+	fs.write(LogMagic, sizeof LogMagic);
+	WriteInt<uint32_t>(fs, LogVersion);
+	WriteInt<uint32_t>(fs, static_cast<uint32_t>(Md5Digest::Len));
+}
+
+// entries of the current log version, each followed by its crc
+static std::string LogEntries(const Database& records)
+{
+	std::string buf{};
+	for (const auto& [path, v] : records)
+	{
+		const auto& [md5, size, date, flags] = v;
+		IntBytes<uint64_t> pathLen{ path.length() };
+		IntBytes<uint64_t> sizeBytes{ size };
+		IntBytes<int64_t> timeBytes{ date.Value };
+		IntBytes<uint32_t> flagsBytes{ flags };
 		if constexpr (Bit::Endian::Native != Bit::Endian::Little)
 		{
-			uint64Buf.data = Bit::EndianSwap(uint64Buf.data);
+			pathLen.data = Bit::EndianSwap(pathLen.data);
+			sizeBytes.data = Bit::EndianSwap(sizeBytes.data);
+			timeBytes.data = Bit::EndianSwap(timeBytes.data);
+			flagsBytes.data = Bit::EndianSwap(flagsBytes.data);
 		}
-		const auto size = uint64Buf.data;
-		
-		const auto md5Offset = pathLen;
-		const auto md5Begin = buf + md5Offset;
-		const auto md5NullQ = buf[md5Offset] == 0;
-		
-		const auto timeOffset = pathLen + md5Len + sizeLen;
-		const auto timeBegin = buf + timeOffset;
-		const auto timeNullQ = buf[timeOffset] == 0;
-		
-		if constexpr (std::is_same<T, Database>::value)
-		{
-			const auto md5 = NullOr(md5NullQ, std::string(), std::string(md5Begin, md5Len));
-			const auto time = NullOr(timeNullQ, std::string(), std::string(timeBegin, timeLen));
-			fmd.emplace(std::string(buf, pathLen), std::make_tuple(md5, size, time));
+		const auto begin = buf.length();
+		buf.append(pathLen.bytes, sizeof pathLen.bytes);
+		buf.append(path);
+		buf.append(reinterpret_cast<const char*>(md5.Data()), Md5Digest::Len);
+		buf.append(sizeBytes.bytes, sizeof sizeBytes.bytes);
+		buf.append(timeBytes.bytes, sizeof timeBytes.bytes);
+		buf.append(flagsBytes.bytes, sizeof flagsBytes.bytes);
+		IntBytes<uint32_t> crc{ Crc32(buf.data() + begin, buf.length() - begin) };
+		if constexpr (Bit::Endian::Native != Bit::Endian::Little)
+		{
+			crc.data = Bit::EndianSwap(crc.data);
+		}
+		buf.append(crc.bytes, sizeof crc.bytes);
+	}
+	return buf;
+}
+
+void AppendLog(const Database& records, const std::filesystem::path& databasePath)
+{
+	const auto logPath = LogPath(databasePath);
+	if (exists(logPath))
+	{
+		// drop a torn tail so the new entries stay reachable
+		uint64_t end = 0;
+		uint32_t logVersion = 0;
+		{
+			const File::MemoryMap map(logPath);
+			end = ScanLog(map, [](const ModelRef&) {});
+			logVersion = LoadInt<uint32_t>(map.Data() + 8);
 		}
-		else if constexpr (std::is_same<T, std::vector<Model>>::value)
+		if (logVersion != LogVersion)
 		{
-			const auto path = StrPtr{ buf, pathLen };
-			const auto md5 = NullOr(md5NullQ, NilStr, (StrPtr{ md5Begin, md5Len }));
-			const auto time = NullOr(timeNullQ, NilStr, (StrPtr{ timeBegin, timeLen }));
-			fmd.push_back(Model{ path, md5, size, time });
+			// entries are never mixed across log versions, the older ones are rewritten together with the new ones
+			// and replace the old log only once they are on disk
+			Database merged{};
+			ReplayLog(merged, databasePath);
+			for (const auto& [path, v] : records) merged[path] = v;
+			WriteAtomic(logPath, [&](std::ofstream& fs)
+			{
+				WriteLogHeader(fs);
+				fs << LogEntries(merged);
+			});
+			return;
 		}
+		if (end != file_size(logPath)) resize_file(logPath, end);
+	}
+	else
+	{
+		std::ofstream fs(logPath, std::ios::binary | std::ios::out);
+		WriteLogHeader(fs);
+		fs.close();
+		if (!fs) throw std::runtime_error("write error: " + logPath.u8string());
 	}
-	if constexpr (std::is_same<T, Database>::value)
+
+	std::ofstream fs(logPath, std::ios::binary | std::ios::out | std::ios::app);
+	fs << LogEntries(records);
+	fs.close();
+	if (!fs) throw std::runtime_error("write error: " + logPath.u8string());
+	File::Sync(logPath);
+}
+
+void ReplayLog(Database& fmd, const std::filesystem::path& databasePath)
+{
+	const auto logPath = LogPath(databasePath);
+	if (!exists(logPath)) return;
+	const File::MemoryMap map(logPath);
+	ScanLog(map, [&](const ModelRef& model)
+	{
+		// log entries hold whole paths
+		fmd[model.Name] = std::make_tuple(model.Md5.Owned(), model.Size, model.Time, model.Flags);
+	});
+}
+
+void MergeLog(std::vector<ModelRef>& fmd, const Database& log)
+{
+	if (log.empty()) return;
+	const auto last = std::remove_if(std::execution::par, fmd.begin(), fmd.end(), [&](const ModelRef& model)
+	{
+		return log.find(model.Path()) != log.end();
+	});
+	fmd.erase(last, fmd.end());
+	for (const auto& [path, v] : log)
 	{
-		delete[] buf;
+		const auto& [md5, size, date, flags] = v;
+		fmd.emplace_back(path, md5, size, date, flags);
 	}
 }
 
-void Deserialization(Database& fmd, const std::filesystem::path& databasePath)
+std::filesystem::path ProgressPath(const std::filesystem::path& databasePath)
 {
-	DeserializationImpl<Database>(fmd, databasePath);
+	auto path = databasePath;
+	path += ".progress";
+	return path;
+}
+
+void SerializationProgress(const BuildProgress& progress, const std::filesystem::path& databasePath)
+{
+	WriteAtomic(ProgressPath(databasePath), [&](std::ofstream& fs)
+	{
+		fs.write(ProgressMagic, sizeof ProgressMagic);
+		WriteInt<uint32_t>(fs, ProgressVersion);
+		WriteInt<uint32_t>(fs, 0);
+		for (const auto* keys : { &progress.Directories, &progress.Files })
+		{
+			WriteInt<uint64_t>(fs, keys->size());
+			for (const auto& key : *keys)
+			{
+				WriteInt<uint64_t>(fs, key.length());
+				fs << key;
+			}
+		}
+	});
 }
 
-void DeserializationAsModel(std::vector<Model>& fmd, const std::filesystem::path& databasePath)
+BuildProgress DeserializationProgress(const std::filesystem::path& databasePath)
 {
-	DeserializationImpl<std::vector<Model>>(fmd, databasePath);
+	const auto progressPath = ProgressPath(databasePath);
+	if (!exists(progressPath)) return {};
+	const File::MemoryMap map(progressPath);
+	const auto* data = map.Data();
+	const auto size = map.Size();
+	if (size < ProgressHeaderLen || memcmp(data, ProgressMagic, sizeof ProgressMagic) != 0) throw std::runtime_error("progress corrupted: bad header");
+	const auto progressVersion = LoadInt<uint32_t>(data + 8);
+	if (progressVersion > ProgressVersion) throw std::runtime_error("unsupported progress version " + std::to_string(progressVersion));
+	BuildProgress progress{};
+	uint64_t offset = ProgressHeaderLen - sizeof(uint64_t);
+	const auto readKeys = [&](std::vector<std::string>& keys)
+	{
+		if (size - offset < sizeof(uint64_t)) throw std::runtime_error("progress corrupted: bad entry");
+		const auto count = LoadInt<uint64_t>(data + offset);
+		offset += sizeof(uint64_t);
+		for (uint64_t i = 0; i < count; ++i)
+		{
+			if (size - offset < sizeof(uint64_t)) throw std::runtime_error("progress corrupted: bad entry");
+			const auto len = LoadInt<uint64_t>(data + offset);
+			offset += sizeof(uint64_t);
+			if (size - offset < len) throw std::runtime_error("progress corrupted: bad entry");
+			keys.emplace_back(data + offset, len);
+			offset += len;
+		}
+	};
+	readKeys(progress.Directories);
+	if (progressVersion >= 2) readKeys(progress.Files);
+	return progress;
 }
@@ -2,10 +2,45 @@
 
 #include <fstream>
 
+#include "File.h"
 #include "FileMd5Database.h"
 
-void Serialization(const Database& fmd, const std::filesystem::path& databasePath);
+// Md5Digest::Len bytes of every digest are stored, loads expect the same width
+void Serialization(const Database& fmd, const std::filesystem::path& databasePath, StorageLayout layout = StorageLayout::Row, HashAlgorithm algorithm = HashAlgorithm::Md5);
+
+// layout of an existing database, Row when it is missing or predates the columnar format
+StorageLayout DatabaseLayout(const std::filesystem::path& databasePath);
+
+// algorithm of the digests of an existing database, Md5 when it is missing or predates version 7
+HashAlgorithm DatabaseAlgorithm(const std::filesystem::path& databasePath);
+
+// digest bytes stored by an existing database, what Md5Digest::Len is set to before it is worked on, 16 when it predates version 10, the whole digest of algorithm when it is missing
+uint64_t DatabaseDigestLen(const std::filesystem::path& databasePath, HashAlgorithm algorithm);
 
 void Deserialization(Database& fmd, const std::filesystem::path& databasePath);
 
-void DeserializationAsModel(std::vector<Model>& fmd, const std::filesystem::path& databasePath);
+// the records reference map and, from format version 8, the directories loaded into tree, which also owns the
+// records decoded from the block layout
+void DeserializationAsModel(std::vector<ModelRef>& fmd, PathTree& tree, const File::MemoryMap& map);
+
+// zero-copy view of a columnar database, returns false if the mapping is in row layout
+bool DeserializationAsColumns(ColumnStore& fmd, PathTree& tree, const File::MemoryMap& map);
+
+// Add appends records to a log next to the database instead of rewriting it, Serialization folds the log into the main file
+std::filesystem::path LogPath(const std::filesystem::path& databasePath);
+
+void AppendLog(const Database& records, const std::filesystem::path& databasePath);
+
+// replays the log over fmd, later records win, a torn tail left by a crash is ignored
+void ReplayLog(Database& fmd, const std::filesystem::path& databasePath);
+
+// replaces the records of fmd that log overrides and appends the new ones, fmd keeps referencing the keys of log
+void MergeLog(std::vector<ModelRef>& fmd, const Database& log);
+
+// what a Build has merged, kept next to the database by checkpoints until the build finishes
+std::filesystem::path ProgressPath(const std::filesystem::path& databasePath);
+
+void SerializationProgress(const BuildProgress& progress, const std::filesystem::path& databasePath);
+
+// version 1 progress files hold no files
+BuildProgress DeserializationProgress(const std::filesystem::path& databasePath);
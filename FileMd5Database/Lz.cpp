@@ -0,0 +1,128 @@
+#include "Lz.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace Lz
+{
+	namespace
+	{
+		constexpr std::uint64_t MinMatch = 4;
+		constexpr std::uint64_t MaxOffset = 65535;
+		// the input ends in literals, so a match never extends into the last bytes
+		constexpr std::uint64_t LastLiterals = 5;
+		constexpr int HashBits = 14;
+		constexpr std::uint64_t RunMask = 15;
+
+		std::uint32_t Load32(const char* p)
+		{
+			std::uint32_t x;
+			memcpy(&x, p, sizeof x);
+			return x;
+		}
+
+		std::uint32_t Hash(const std::uint32_t x)
+		{
+			return x * 2654435761u >> (32 - HashBits);
+		}
+
+		char* WriteLength(char* op, std::uint64_t len)
+		{
+			for (; len >= 255; len -= 255) *op++ = static_cast<char>(255);
+			*op++ = static_cast<char>(len);
+			return op;
+		}
+
+		char* WriteSequence(char* op, const char* literals, const std::uint64_t literalLen, const std::uint64_t offset, const std::uint64_t matchLen)
+		{
+			auto* token = op++;
+			const auto extra = matchLen == 0 ? 0 : matchLen - MinMatch;
+			*token = static_cast<char>(std::min(literalLen, RunMask) << 4 | std::min(extra, RunMask));
+			if (literalLen >= RunMask) op = WriteLength(op, literalLen - RunMask);
+			memcpy(op, literals, literalLen);
+			op += literalLen;
+			if (matchLen == 0) return op;
+			*op++ = static_cast<char>(offset & 0xff);
+			*op++ = static_cast<char>(offset >> 8);
+			if (extra >= RunMask) op = WriteLength(op, extra - RunMask);
+			return op;
+		}
+	}
+
+	std::uint64_t Compress(const char* src, const std::uint64_t len, char* dst)
+	{
+		std::vector<std::uint32_t> table(std::size_t{ 1 } << HashBits);
+		auto* op = dst;
+		std::uint64_t anchor = 0;
+		std::uint64_t ip = 0;
+		const auto end = len > LastLiterals ? len - LastLiterals : 0;
+		while (ip + MinMatch <= end)
+		{
+			const auto h = Hash(Load32(src + ip));
+			const std::uint64_t candidate = table[h];
+			table[h] = static_cast<std::uint32_t>(ip);
+			if (candidate >= ip || ip - candidate > MaxOffset || Load32(src + candidate) != Load32(src + ip))
+			{
+				++ip;
+				continue;
+			}
+			auto matchLen = MinMatch;
+			while (ip + matchLen < end && src[candidate + matchLen] == src[ip + matchLen]) ++matchLen;
+			op = WriteSequence(op, src + anchor, ip - anchor, ip - candidate, matchLen);
+			ip += matchLen;
+			anchor = ip;
+		}
+		op = WriteSequence(op, src + anchor, len - anchor, 0, 0);
+		return static_cast<std::uint64_t>(op - dst);
+	}
+
+	bool Decompress(const char* src, const std::uint64_t srcLen, char* dst, const std::uint64_t len)
+	{
+		const auto* ip = src;
+		const auto* const ipEnd = src + srcLen;
+		auto* op = dst;
+		auto* const opEnd = dst + len;
+		const auto readLength = [&](std::uint64_t& n)
+		{
+			while (ip != ipEnd)
+			{
+				const auto b = static_cast<std::uint8_t>(*ip++);
+				n += b;
+				if (b != 255) return true;
+			}
+			return false;
+		};
+		while (ip != ipEnd)
+		{
+			const auto token = static_cast<std::uint8_t>(*ip++);
+			std::uint64_t literalLen = token >> 4;
+			if (literalLen == RunMask && !readLength(literalLen)) return false;
+			if (static_cast<std::uint64_t>(ipEnd - ip) < literalLen || static_cast<std::uint64_t>(opEnd - op) < literalLen) return false;
+			memcpy(op, ip, literalLen);
+			ip += literalLen;
+			op += literalLen;
+			if (ip == ipEnd) break;
+
+			if (ipEnd - ip < 2) return false;
+			const std::uint64_t offset = static_cast<std::uint8_t>(ip[0]) | static_cast<std::uint64_t>(static_cast<std::uint8_t>(ip[1])) << 8;
+			ip += 2;
+			std::uint64_t matchLen = token & RunMask;
+			if (matchLen == RunMask && !readLength(matchLen)) return false;
+			matchLen += MinMatch;
+			if (offset == 0 || offset > static_cast<std::uint64_t>(op - dst) || static_cast<std::uint64_t>(opEnd - op) < matchLen) return false;
+			const auto* match = op - offset;
+			if (offset >= matchLen)
+			{
+				memcpy(op, match, matchLen);
+				op += matchLen;
+			}
+			else
+			{
+				// the copy overlaps its own output and repeats the last offset bytes
+				for (std::uint64_t i = 0; i < matchLen; ++i) *op++ = *match++;
+			}
+		}
+		return op == opEnd;
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+// LZ4-style block compression: sequences of a literal run followed by a copy of at least 4 earlier bytes
+// from at most 64 KiB back, the last sequence is literals only
+namespace Lz
+{
+	// the largest output of Compress for len bytes of input
+	constexpr std::uint64_t Bound(const std::uint64_t len)
+	{
+		return len + len / 255 + 16;
+	}
+
+	// dst holds Bound(len) bytes, returns the compressed length
+	std::uint64_t Compress(const char* src, std::uint64_t len, char* dst);
+
+	// false unless src is well formed and decodes to exactly len bytes
+	bool Decompress(const char* src, std::uint64_t srcLen, char* dst, std::uint64_t len);
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+#include "Cryptography.h"
+
+namespace Cryptography::MultiBuffer
+{
+	bool Md5Sse2(const std::string_view* messages, std::size_t count, Md5::DigestData* digests);
+
+	bool Md5Avx2(const std::string_view* messages, std::size_t count, Md5::DigestData* digests);
+
+	bool Md5Avx512(const std::string_view* messages, std::size_t count, Md5::DigestData* digests);
+
+	// internal linkage on purpose: every ISA translation unit is built with its own target flags
+	namespace
+	{
+		constexpr std::uint32_t Md5K[64]
+		{
+			0xd76aa478u, 0xe8c7b756u, 0x242070dbu, 0xc1bdceeeu, 0xf57c0fafu, 0x4787c62au, 0xa8304613u, 0xfd469501u,
+			0x698098d8u, 0x8b44f7afu, 0xffff5bb1u, 0x895cd7beu, 0x6b901122u, 0xfd987193u, 0xa679438eu, 0x49b40821u,
+			0xf61e2562u, 0xc040b340u, 0x265e5a51u, 0xe9b6c7aau, 0xd62f105du, 0x02441453u, 0xd8a1e681u, 0xe7d3fbc8u,
+			0x21e1cde6u, 0xc33707d6u, 0xf4d50d87u, 0x455a14edu, 0xa9e3e905u, 0xfcefa3f8u, 0x676f02d9u, 0x8d2a4c8au,
+			0xfffa3942u, 0x8771f681u, 0x6d9d6122u, 0xfde5380cu, 0xa4beea44u, 0x4bdecfa9u, 0xf6bb4b60u, 0xbebfbc70u,
+			0x289b7ec6u, 0xeaa127fau, 0xd4ef3085u, 0x04881d05u, 0xd9d4d039u, 0xe6db99e5u, 0x1fa27cf8u, 0xc4ac5665u,
+			0xf4292244u, 0x432aff97u, 0xab9423a7u, 0xfc93a039u, 0x655b59c3u, 0x8f0ccc92u, 0xffeff47du, 0x85845dd1u,
+			0x6fa87e4fu, 0xfe2ce6e0u, 0xa3014314u, 0x4e0811a1u, 0xf7537e82u, 0xbd3af235u, 0x2ad7d2bbu, 0xeb86d391u
+		};
+
+		constexpr int Md5S[64]
+		{
+			7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+			5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+			4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+			6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+		};
+
+		constexpr int Md5W[64]
+		{
+			0, 1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+			1, 6, 11,  0,  5, 10, 15,  4,  9, 14,  3,  8, 13,  2,  7, 12,
+			5, 8, 11, 14,  1,  4,  7, 10, 13,  0,  3,  6,  9, 12, 15,  2,
+			0, 7, 14,  5, 12,  3, 10,  1,  8, 15,  6, 13,  4, 11,  2,  9
+		};
+
+		template<typename Isa, std::size_t I>
+		inline void Md5Step(typename Isa::V (&s)[4], const typename Isa::V* w)
+		{
+			auto& a = s[(4 - I % 4) % 4];
+			const auto b = s[(5 - I % 4) % 4];
+			const auto c = s[(6 - I % 4) % 4];
+			const auto d = s[(7 - I % 4) % 4];
+			typename Isa::V f;
+			if constexpr (I < 16) f = Isa::F(b, c, d);
+			else if constexpr (I < 32) f = Isa::G(b, c, d);
+			else if constexpr (I < 48) f = Isa::H(b, c, d);
+			else f = Isa::I(b, c, d);
+			a = Isa::Add(a, Isa::Add(f, Isa::Add(w[Md5W[I]], Isa::Set1(Md5K[I]))));
+			a = Isa::template Rotl<Md5S[I]>(a);
+			a = Isa::Add(a, b);
+		}
+
+		template<typename Isa, std::size_t... I>
+		inline void Md5Rounds(typename Isa::V (&s)[4], const typename Isa::V* w, std::index_sequence<I...>)
+		{
+			(Md5Step<Isa, I>(s, w), ...);
+		}
+
+		struct Md5Lane
+		{
+			const std::uint8_t* Data = nullptr;
+			std::uint64_t Block = 0;
+			std::uint64_t FullBlocks = 0;
+			std::uint64_t TotalBlocks = 0;
+			std::size_t Message = 0;
+			bool Active = false;
+			std::uint8_t Tail[128]{};
+
+			void Assign(const std::string_view& message, const std::size_t index)
+			{
+				const auto len = static_cast<std::uint64_t>(message.size());
+				const auto rem = len & 0x3fu;
+				Data = reinterpret_cast<const std::uint8_t*>(message.data());
+				Block = 0;
+				FullBlocks = len >> 6u;
+				TotalBlocks = FullBlocks + (rem + 9 > 64 ? 2 : 1);
+				Message = index;
+				Active = true;
+
+				memset(Tail, 0, sizeof Tail);
+				if (rem != 0) memcpy(Tail, Data + FullBlocks * 64, rem);
+				Tail[rem] = 0x80u;
+				const auto bits = len << 3u;
+				const auto end = (TotalBlocks - FullBlocks) * 64;
+				for (auto i = 0u; i < 8; ++i) Tail[end - 8 + i] = static_cast<std::uint8_t>(bits >> (8 * i));
+			}
+
+			[[nodiscard]] const std::uint8_t* Current() const
+			{
+				return Block < FullBlocks ? Data + Block * 64 : Tail + (Block - FullBlocks) * 64;
+			}
+		};
+
+		template<typename Isa>
+		void Md5Hash(const std::string_view* messages, const std::size_t count, Md5::DigestData* digests)
+		{
+			using V = typename Isa::V;
+			constexpr auto lanes = Isa::Lanes;
+			static const std::uint8_t zero[64]{};
+
+			Md5Lane lane[lanes]{};
+			alignas(64) std::uint32_t state[4][lanes];
+			alignas(64) std::uint32_t words[16][lanes];
+			V s[4];
+			V w[16];
+
+			std::size_t next = 0;
+			std::size_t active = 0;
+			for (std::size_t l = 0; l < lanes; ++l)
+			{
+				state[0][l] = 0x67452301u;
+				state[1][l] = 0xefcdab89u;
+				state[2][l] = 0x98badcfeu;
+				state[3][l] = 0x10325476u;
+				if (next < count)
+				{
+					lane[l].Assign(messages[next], next);
+					++next;
+					++active;
+				}
+			}
+			for (auto i = 0; i < 4; ++i) s[i] = Isa::Load(state[i]);
+
+			while (active != 0)
+			{
+				for (std::size_t l = 0; l < lanes; ++l)
+				{
+					const auto* block = lane[l].Active ? lane[l].Current() : zero;
+					for (auto i = 0; i < 16; ++i) memcpy(&words[i][l], block + i * 4, 4);
+				}
+				for (auto i = 0; i < 16; ++i) w[i] = Isa::Load(words[i]);
+
+				V saved[4]{ s[0], s[1], s[2], s[3] };
+				Md5Rounds<Isa>(s, w, std::make_index_sequence<64>{});
+				for (auto i = 0; i < 4; ++i) s[i] = Isa::Add(s[i], saved[i]);
+
+				auto finished = false;
+				for (auto& l : lane) if (l.Active && ++l.Block == l.TotalBlocks) finished = true;
+				if (!finished) continue;
+
+				for (auto i = 0; i < 4; ++i) Isa::Store(state[i], s[i]);
+				for (std::size_t l = 0; l < lanes; ++l)
+				{
+					if (!lane[l].Active || lane[l].Block != lane[l].TotalBlocks) continue;
+					auto& digest = digests[lane[l].Message];
+					digest.DWord.A = state[0][l];
+					digest.DWord.B = state[1][l];
+					digest.DWord.C = state[2][l];
+					digest.DWord.D = state[3][l];
+					lane[l].Active = false;
+					--active;
+					if (next < count)
+					{
+						state[0][l] = 0x67452301u;
+						state[1][l] = 0xefcdab89u;
+						state[2][l] = 0x98badcfeu;
+						state[3][l] = 0x10325476u;
+						lane[l].Assign(messages[next], next);
+						++next;
+						++active;
+					}
+				}
+				for (auto i = 0; i < 4; ++i) s[i] = Isa::Load(state[i]);
+			}
+		}
+	}
+}
@@ -0,0 +1,48 @@
+#include "Md5MultiBuffer.h"
+
+#if defined(__AVX2__) || (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)))
+
+#include <immintrin.h>
+
+namespace Cryptography::MultiBuffer
+{
+	namespace
+	{
+		struct Avx2
+		{
+			using V = __m256i;
+			static constexpr std::size_t Lanes = 8;
+
+			static V Load(const std::uint32_t* p) { return _mm256_load_si256(reinterpret_cast<const V*>(p)); }
+			static void Store(std::uint32_t* p, const V v) { _mm256_store_si256(reinterpret_cast<V*>(p), v); }
+			static V Set1(const std::uint32_t x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+			static V Add(const V a, const V b) { return _mm256_add_epi32(a, b); }
+
+			template<int S>
+			static V Rotl(const V a) { return _mm256_or_si256(_mm256_slli_epi32(a, S), _mm256_srli_epi32(a, 32 - S)); }
+
+			static V F(const V x, const V y, const V z) { return _mm256_xor_si256(z, _mm256_and_si256(x, _mm256_xor_si256(y, z))); }
+			static V G(const V x, const V y, const V z) { return _mm256_xor_si256(y, _mm256_and_si256(z, _mm256_xor_si256(x, y))); }
+			static V H(const V x, const V y, const V z) { return _mm256_xor_si256(_mm256_xor_si256(x, y), z); }
+			static V I(const V x, const V y, const V z) { return _mm256_xor_si256(y, _mm256_or_si256(x, _mm256_xor_si256(z, _mm256_set1_epi32(-1)))); }
+		};
+	}
+
+	bool Md5Avx2(const std::string_view* messages, const std::size_t count, Md5::DigestData* digests)
+	{
+		Md5Hash<Avx2>(messages, count, digests);
+		return true;
+	}
+}
+
+#else
+
+namespace Cryptography::MultiBuffer
+{
+	bool Md5Avx2(const std::string_view*, std::size_t, Md5::DigestData*)
+	{
+		return false;
+	}
+}
+
+#endif
@@ -0,0 +1,48 @@
+#include "Md5MultiBuffer.h"
+
+#if defined(__AVX512F__) || (defined(_MSC_VER) && defined(_M_X64))
+
+#include <immintrin.h>
+
+namespace Cryptography::MultiBuffer
+{
+	namespace
+	{
+		struct Avx512
+		{
+			using V = __m512i;
+			static constexpr std::size_t Lanes = 16;
+
+			static V Load(const std::uint32_t* p) { return _mm512_load_si512(p); }
+			static void Store(std::uint32_t* p, const V v) { _mm512_store_si512(p, v); }
+			static V Set1(const std::uint32_t x) { return _mm512_set1_epi32(static_cast<int>(x)); }
+			static V Add(const V a, const V b) { return _mm512_add_epi32(a, b); }
+
+			template<int S>
+			static V Rotl(const V a) { return _mm512_rol_epi32(a, S); }
+
+			static V F(const V x, const V y, const V z) { return _mm512_ternarylogic_epi32(x, y, z, 0xca); }
+			static V G(const V x, const V y, const V z) { return _mm512_ternarylogic_epi32(x, y, z, 0xe4); }
+			static V H(const V x, const V y, const V z) { return _mm512_ternarylogic_epi32(x, y, z, 0x96); }
+			static V I(const V x, const V y, const V z) { return _mm512_ternarylogic_epi32(x, y, z, 0x39); }
+		};
+	}
+
+	bool Md5Avx512(const std::string_view* messages, const std::size_t count, Md5::DigestData* digests)
+	{
+		Md5Hash<Avx512>(messages, count, digests);
+		return true;
+	}
+}
+
+#else
+
+namespace Cryptography::MultiBuffer
+{
+	bool Md5Avx512(const std::string_view*, std::size_t, Md5::DigestData*)
+	{
+		return false;
+	}
+}
+
+#endif
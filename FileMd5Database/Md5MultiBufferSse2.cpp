@@ -0,0 +1,48 @@
+#include "Md5MultiBuffer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+
+namespace Cryptography::MultiBuffer
+{
+	namespace
+	{
+		struct Sse2
+		{
+			using V = __m128i;
+			static constexpr std::size_t Lanes = 4;
+
+			static V Load(const std::uint32_t* p) { return _mm_load_si128(reinterpret_cast<const V*>(p)); }
+			static void Store(std::uint32_t* p, const V v) { _mm_store_si128(reinterpret_cast<V*>(p), v); }
+			static V Set1(const std::uint32_t x) { return _mm_set1_epi32(static_cast<int>(x)); }
+			static V Add(const V a, const V b) { return _mm_add_epi32(a, b); }
+
+			template<int S>
+			static V Rotl(const V a) { return _mm_or_si128(_mm_slli_epi32(a, S), _mm_srli_epi32(a, 32 - S)); }
+
+			static V F(const V x, const V y, const V z) { return _mm_xor_si128(z, _mm_and_si128(x, _mm_xor_si128(y, z))); }
+			static V G(const V x, const V y, const V z) { return _mm_xor_si128(y, _mm_and_si128(z, _mm_xor_si128(x, y))); }
+			static V H(const V x, const V y, const V z) { return _mm_xor_si128(_mm_xor_si128(x, y), z); }
+			static V I(const V x, const V y, const V z) { return _mm_xor_si128(y, _mm_or_si128(x, _mm_xor_si128(z, _mm_set1_epi32(-1)))); }
+		};
+	}
+
+	bool Md5Sse2(const std::string_view* messages, const std::size_t count, Md5::DigestData* digests)
+	{
+		Md5Hash<Sse2>(messages, count, digests);
+		return true;
+	}
+}
+
+#else
+
+namespace Cryptography::MultiBuffer
+{
+	bool Md5Sse2(const std::string_view*, std::size_t, Md5::DigestData*)
+	{
+		return false;
+	}
+}
+
+#endif
@@ -0,0 +1,213 @@
+#include "PathMatcher.h"
+
+#include <algorithm>
+#include <filesystem>
+
+static bool IsGlob(const std::string_view pattern)
+{
+	return pattern.find_first_of("*?[") != std::string_view::npos;
+}
+
+// one character of the pattern at p against c, p moves past a character class
+static bool CharMatch(const std::string_view pattern, std::size_t& p, const char c)
+{
+	const auto pc = pattern[p++];
+	if (pc == '?') return c != '/';
+	if (pc != '[') return pc == c;
+	const auto end = pattern.find(']', p + 1);
+	if (end == std::string_view::npos) return c == '[';
+	const auto negate = pattern[p] == '!' || pattern[p] == '^';
+	auto matched = false;
+	for (auto i = p + (negate ? 1 : 0); i < end; ++i)
+	{
+		if (i + 2 < end && pattern[i + 1] == '-')
+		{
+			matched = matched || (pattern[i] <= c && c <= pattern[i + 2]);
+			i += 2;
+		}
+		else
+		{
+			matched = matched || pattern[i] == c;
+		}
+	}
+	p = end + 1;
+	return matched != negate && c != '/';
+}
+
+// * and ? never match a /, ** matches anything including / and a "**/" starting a component also no directory at all,
+// a mismatch resumes after the last * unless that would take a /, then after the last **, which is all the backtracking it needs
+static bool GlobMatch(const std::string_view pattern, const std::string_view text)
+{
+	constexpr auto none = std::string_view::npos;
+	std::size_t p = 0;
+	std::size_t t = 0;
+	auto starP = none;
+	std::size_t starT = 0;
+	auto deepP = none;
+	std::size_t deepT = 0;
+	auto deepDirectory = false;
+	for (;;)
+	{
+		if (p < pattern.size() && pattern[p] == '*')
+		{
+			if (p + 1 < pattern.size() && pattern[p + 1] == '*')
+			{
+				deepDirectory = (p == 0 || pattern[p - 1] == '/') && p + 2 < pattern.size() && pattern[p + 2] == '/';
+				p += deepDirectory ? 3 : 2;
+				deepP = p;
+				deepT = t;
+				starP = none;
+			}
+			else
+			{
+				starP = ++p;
+				starT = t;
+			}
+			continue;
+		}
+		if (p < pattern.size() && t < text.size())
+		{
+			auto next = p;
+			if (CharMatch(pattern, next, text[t]))
+			{
+				p = next;
+				++t;
+				continue;
+			}
+		}
+		else if (p == pattern.size() && t == text.size())
+		{
+			return true;
+		}
+		if (starP != none && starT < text.size() && text[starT] != '/')
+		{
+			p = starP;
+			t = ++starT;
+			continue;
+		}
+		if (deepP == none) return false;
+		if (deepDirectory)
+		{
+			const auto slash = text.find('/', deepT);
+			if (slash == none) return false;
+			deepT = slash + 1;
+		}
+		else
+		{
+			if (deepT >= text.size()) return false;
+			++deepT;
+		}
+		p = deepP;
+		t = deepT;
+		starP = none;
+	}
+}
+
+std::string PathMatcher::Normalize(const std::string_view path)
+{
+	std::string res(path);
+	if constexpr (std::filesystem::path::preferred_separator == '\\') std::replace(res.begin(), res.end(), '\\', '/');
+	while (res.size() > 1 && res.back() == '/') res.pop_back();
+	return res;
+}
+
+PathMatcher::PathMatcher(const std::vector<std::string>& patterns)
+{
+	for (const auto& raw : patterns)
+	{
+		const auto pattern = Normalize(raw);
+		if (pattern.empty()) continue;
+		empty = false;
+		const auto slash = pattern.find('/') != std::string::npos;
+		if (!IsGlob(pattern))
+		{
+			if (!slash)
+			{
+				names.insert(pattern);
+				continue;
+			}
+			auto* node = &prefixes;
+			std::size_t begin = 0;
+			while (begin <= pattern.size())
+			{
+				const auto end = std::min(pattern.find('/', begin), pattern.size());
+				auto& child = node->Children[pattern.substr(begin, end - begin)];
+				if (!child) child = std::make_unique<Node>();
+				node = child.get();
+				begin = end + 1;
+			}
+			node->Terminal = true;
+			continue;
+		}
+		// "**/name" and "*suffix" are the common cases and need no glob matching
+		if (pattern.rfind("**/", 0) == 0 && !IsGlob(pattern.substr(3)) && pattern.find('/', 3) == std::string::npos)
+		{
+			names.insert(pattern.substr(3));
+		}
+		else if (!slash && pattern[0] == '*' && !IsGlob(pattern.substr(1)))
+		{
+			AddTail(pattern.substr(1))->Terminal = true;
+		}
+		else
+		{
+			// a glob is only tried on paths ending with the literal text after its last wildcard
+			const auto at = pattern.find_last_of("*?[]") + 1;
+			auto literal = std::string_view(pattern).substr(at);
+			// the / of a "**/" is optional
+			if (!literal.empty() && literal[0] == '/' && at >= 2 && pattern.compare(at - 2, 2, "**") == 0) literal.remove_prefix(1);
+			AddTail(literal)->Globs.push_back({ pattern, !slash });
+		}
+	}
+}
+
+PathMatcher::Tail* PathMatcher::AddTail(const std::string_view literal)
+{
+	auto* node = &tails;
+	for (auto c = literal.rbegin(); c != literal.rend(); ++c)
+	{
+		auto& child = node->Children[*c];
+		if (!child) child = std::make_unique<Tail>();
+		node = child.get();
+	}
+	return node;
+}
+
+bool PathMatcher::Match(const std::string& path) const
+{
+	if (empty) return false;
+	const auto normalized = Normalize(path);
+	const auto slash = normalized.rfind('/');
+	const auto name = std::string_view(normalized).substr(slash == std::string::npos ? 0 : slash + 1);
+
+	if (!names.empty() && names.find(std::string(name)) != names.end()) return true;
+
+	if (!prefixes.Children.empty())
+	{
+		const auto* node = &prefixes;
+		std::size_t begin = 0;
+		while (begin <= normalized.size())
+		{
+			const auto end = std::min(normalized.find('/', begin), normalized.size());
+			const auto child = node->Children.find(normalized.substr(begin, end - begin));
+			if (child == node->Children.end()) break;
+			node = child->second.get();
+			if (node->Terminal) return true;
+			begin = end + 1;
+		}
+	}
+
+	// suffixes hold no /, so one that the path ends with lies within the name
+	const auto* node = &tails;
+	for (auto i = normalized.size();; --i)
+	{
+		if (node->Terminal) return true;
+		if (std::any_of(node->Globs.begin(), node->Globs.end(), [&](const Glob& glob)
+		{
+			return GlobMatch(glob.Pattern, glob.Name ? name : std::string_view(normalized));
+		})) return true;
+		if (i == 0) return false;
+		const auto child = node->Children.find(normalized[i - 1]);
+		if (child == node->Children.end()) return false;
+		node = child->second.get();
+	}
+}
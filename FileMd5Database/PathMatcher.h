@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// matches paths against a compiled set of patterns:
+//   "/data/cache"      the path and everything below it
+//   "node_modules"     any file or directory with that name
+//   "*.tmp"            names with that suffix
+//   "**/build/*.o"     globs, * and ? stay within a component, ** spans components and a leading "**/" of a component
+//                      also matches none, [a-z] and [!a] are character classes
+// patterns without a / match the name, the others the whole path, \ is a separator on windows
+class PathMatcher
+{
+public:
+	PathMatcher() = default;
+	explicit PathMatcher(const std::vector<std::string>& patterns);
+
+	[[nodiscard]] bool Match(const std::string& path) const;
+
+	[[nodiscard]] bool Empty() const { return empty; }
+
+private:
+	struct Node
+	{
+		std::unordered_map<std::string, std::unique_ptr<Node>> Children{};
+		bool Terminal = false;
+	};
+
+	struct Glob
+	{
+		std::string Pattern;
+		bool Name;
+	};
+
+	// reversed trie of the literal ends of suffix rules and globs, a path walks it from its last character
+	struct Tail
+	{
+		std::unordered_map<char, std::unique_ptr<Tail>> Children{};
+		bool Terminal = false;
+		std::vector<Glob> Globs{};
+	};
+
+	static std::string Normalize(std::string_view path);
+
+	Tail* AddTail(std::string_view literal);
+
+	bool empty = true;
+	Node prefixes{};
+	std::unordered_set<std::string> names{};
+	Tail tails{};
+};
@@ -0,0 +1,117 @@
+#include "Cryptography.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "Cpu.h"
+#include "Sha256.h"
+
+namespace Cryptography
+{
+	namespace
+	{
+		constexpr std::uint32_t Rotr(const std::uint32_t x, const int n)
+		{
+			return x >> n | x << (32 - n);
+		}
+
+		std::uint32_t LoadBe32(const std::uint8_t* p)
+		{
+			return static_cast<std::uint32_t>(p[0]) << 24 | static_cast<std::uint32_t>(p[1]) << 16 | static_cast<std::uint32_t>(p[2]) << 8 | p[3];
+		}
+
+		void Sha256Scalar(std::uint32_t* state, const std::uint8_t* blocks, std::uint64_t n)
+		{
+			for (; n != 0; --n, blocks += 64)
+			{
+				std::uint32_t w[64];
+				for (auto i = 0; i < 16; ++i) w[i] = LoadBe32(blocks + i * 4);
+				for (auto i = 16; i < 64; ++i)
+				{
+					const auto s0 = Rotr(w[i - 15], 7) ^ Rotr(w[i - 15], 18) ^ w[i - 15] >> 3;
+					const auto s1 = Rotr(w[i - 2], 17) ^ Rotr(w[i - 2], 19) ^ w[i - 2] >> 10;
+					w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+				}
+
+				auto a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f = state[5], g = state[6], h = state[7];
+				for (auto i = 0; i < 64; ++i)
+				{
+					const auto t1 = h + (Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25)) + ((e & f) ^ (~e & g)) + Sha::Sha256K[i] + w[i];
+					const auto t2 = (Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+					h = g;
+					g = f;
+					f = e;
+					e = d + t1;
+					d = c;
+					c = b;
+					b = a;
+					a = t1 + t2;
+				}
+				state[0] += a;
+				state[1] += b;
+				state[2] += c;
+				state[3] += d;
+				state[4] += e;
+				state[5] += f;
+				state[6] += g;
+				state[7] += h;
+			}
+		}
+	}
+
+	Sha256::Sha256() : state{ 0x6a09e667u, 0xbb67ae85u, 0x3c6ef372u, 0xa54ff53au, 0x510e527fu, 0x9b05688cu, 0x1f83d9abu, 0x5be0cd19u } {}
+
+	void Sha256::Compress(const std::uint8_t* blocks, const std::uint64_t n)
+	{
+		static const auto shaNi = Cpu::Sha();
+		if (shaNi && Sha::Sha256ShaNi(state, blocks, n)) return;
+		Sha256Scalar(state, blocks, n);
+	}
+
+	void Sha256::Append(const std::uint8_t* buf, std::uint64_t len)
+	{
+		if (finished) throw std::runtime_error("append error: finished");
+		length += len;
+
+		if (bufferLen != 0)
+		{
+			const auto take = std::min<std::uint64_t>(64 - bufferLen, len);
+			memcpy(buffer + bufferLen, buf, take);
+			bufferLen += static_cast<std::uint8_t>(take);
+			buf += take;
+			len -= take;
+			if (bufferLen < 64) return;
+			Compress(buffer, 1);
+			bufferLen = 0;
+		}
+
+		const auto n = len >> 6u;
+		Compress(buf, n);
+		bufferLen = static_cast<std::uint8_t>(len & 0x3fu);
+		if (bufferLen != 0) memcpy(buffer, buf + n * 64, bufferLen);
+	}
+
+	Sha256::DigestData Sha256::Digest()
+	{
+		if (finished) return data;
+		const auto bits = length << 3u;
+		buffer[bufferLen++] = 0x80u;
+		if (bufferLen > 56)
+		{
+			memset(buffer + bufferLen, 0, 64 - bufferLen);
+			Compress(buffer, 1);
+			bufferLen = 0;
+		}
+		memset(buffer + bufferLen, 0, 56 - bufferLen);
+		for (auto i = 0; i < 8; ++i) buffer[56 + i] = static_cast<std::uint8_t>(bits >> (56 - 8 * i));
+		Compress(buffer, 1);
+
+		for (auto i = 0; i < 8; ++i)
+		{
+			for (auto j = 0; j < 4; ++j) data[i * 4 + j] = static_cast<std::uint8_t>(state[i] >> (24 - 8 * j));
+		}
+		finished = true;
+		return data;
+	}
+}
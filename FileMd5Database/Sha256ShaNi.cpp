@@ -0,0 +1,80 @@
+#include "Sha256.h"
+
+#if defined(__SHA__) || (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)))
+
+#include <immintrin.h>
+
+#include <utility>
+
+namespace Cryptography::Sha
+{
+	namespace
+	{
+		// four rounds per step, the message schedule runs one step ahead with msg1 and two with msg2
+		template<std::size_t I>
+		inline void Sha256Step(__m128i& state0, __m128i& state1, __m128i (&w)[4])
+		{
+			auto msg = _mm_add_epi32(w[I % 4], _mm_loadu_si128(reinterpret_cast<const __m128i*>(Sha256K + I * 4)));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			if constexpr (I >= 3 && I <= 14)
+			{
+				auto& next = w[(I + 1) % 4];
+				next = _mm_sha256msg2_epu32(_mm_add_epi32(next, _mm_alignr_epi8(w[I % 4], w[(I + 3) % 4], 4)), w[I % 4]);
+			}
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			if constexpr (I >= 1 && I <= 12)
+			{
+				w[(I + 3) % 4] = _mm_sha256msg1_epu32(w[(I + 3) % 4], w[I % 4]);
+			}
+		}
+
+		template<std::size_t... I>
+		inline void Sha256Steps(__m128i& state0, __m128i& state1, __m128i (&w)[4], std::index_sequence<I...>)
+		{
+			(Sha256Step<I>(state0, state1, w), ...);
+		}
+	}
+
+	bool Sha256ShaNi(std::uint32_t* state, const std::uint8_t* blocks, std::uint64_t n)
+	{
+		const auto mask = _mm_set_epi64x(0x0c0d0e0f08090a0bll, 0x0405060700010203ll);
+
+		// the rounds work on ABEF and CDGH
+		auto tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xb1);
+		auto state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1b);
+		auto state0 = _mm_alignr_epi8(tmp, state1, 8);
+		state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+		for (; n != 0; --n, blocks += 64)
+		{
+			const auto abef = state0;
+			const auto cdgh = state1;
+			__m128i w[4];
+			for (auto i = 0; i < 4; ++i) w[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(blocks + i * 16)), mask);
+			Sha256Steps(state0, state1, w, std::make_index_sequence<16>{});
+			state0 = _mm_add_epi32(state0, abef);
+			state1 = _mm_add_epi32(state1, cdgh);
+		}
+
+		tmp = _mm_shuffle_epi32(state0, 0x1b);
+		state1 = _mm_shuffle_epi32(state1, 0xb1);
+		state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+		state1 = _mm_alignr_epi8(state1, tmp, 8);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(state), state0);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), state1);
+		return true;
+	}
+}
+
+#else
+
+namespace Cryptography::Sha
+{
+	bool Sha256ShaNi(std::uint32_t*, const std::uint8_t*, std::uint64_t)
+	{
+		return false;
+	}
+}
+
+#endif
@@ -0,0 +1,71 @@
+# a dedup build over a database built in full mode keeps its full digests and still finds the new copies of those files
+# cmake -DFMD=<fmd> -DWORK=<scratch directory> -P Dedup.cmake
+
+cmake_minimum_required(VERSION 3.9)
+
+function(Run)
+	execute_process(COMMAND ${FMD} ${ARGN} --disableconsolelog RESULT_VARIABLE res OUTPUT_QUIET ERROR_QUIET)
+	if(NOT res EQUAL 0)
+		message(FATAL_ERROR "fmd ${ARGN} failed: ${res}")
+	endif()
+endfunction()
+
+# 256 KiB of c, more than the head and tail a partial hash reads
+function(Content var c)
+	set(res ${c})
+	foreach(i RANGE 1 18)
+		set(res "${res}${res}")
+	endforeach()
+	set(${var} ${res} PARENT_SCOPE)
+endfunction()
+
+# the digest and flags of path in the exported csv
+function(Record csv path digest flags)
+	file(STRINGS ${csv} lines REGEX "^\"${path}\",")
+	if(NOT lines MATCHES "^\"[^\"]*\",\"[^\"]*\",\"([^\"]*)\",\"[^\"]*\",\"[^\"]*\",\"([^\"]*)\"$")
+		message(FATAL_ERROR "no record of ${path} in ${csv}")
+	endif()
+	set(${digest} "${CMAKE_MATCH_1}" PARENT_SCOPE)
+	set(${flags} "${CMAKE_MATCH_2}" PARENT_SCOPE)
+endfunction()
+
+set(root ${WORK}/tree)
+set(db ${WORK}/test.db)
+file(REMOVE_RECURSE ${WORK})
+file(MAKE_DIRECTORY ${root})
+
+Content(a a)
+Content(c c)
+Content(d d)
+Content(f f)
+file(WRITE ${root}/a ${a})
+file(WRITE ${root}/b ${a})
+file(WRITE ${root}/c ${c})
+# no other file starts like f, a dedup build alone would leave it with a partial digest
+file(WRITE ${root}/f ${f})
+string(MD5 md5A "${a}")
+string(MD5 md5C "${c}")
+string(MD5 md5F "${f}")
+
+Run(Build --device test --root ${root} -p ${db})
+file(WRITE ${root}/d ${d})
+file(WRITE ${root}/e ${c})
+Run(Build --device test --root ${root} -p ${db} --mode Dedup)
+Run(Export -p ${db} --exportPath ${WORK}/test.csv --exoprtFormat CSV)
+
+foreach(name a b c e f)
+	Record(${WORK}/test.csv ${root}/${name} digest flags)
+	set(expected ${md5C})
+	if(name MATCHES "^[ab]$")
+		set(expected ${md5A})
+	elseif(name STREQUAL "f")
+		set(expected ${md5F})
+	endif()
+	if(NOT digest STREQUAL expected OR NOT flags STREQUAL "")
+		message(FATAL_ERROR "${name}: expected full digest ${expected}, got ${digest} ${flags}")
+	endif()
+endforeach()
+Record(${WORK}/test.csv ${root}/d digest flags)
+if(NOT flags STREQUAL "partial")
+	message(FATAL_ERROR "d: expected a partial digest, got ${digest} ${flags}")
+endif()
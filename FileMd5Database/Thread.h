@@ -1,8 +1,18 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstdint>
 #include <mutex>
 #include <list>
+#include <deque>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace Thread
 {
@@ -37,4 +47,206 @@ namespace Thread
         std::mutex mtx{};
         std::condition_variable cv{};
     };
+
+    template<typename T>
+    class BoundedChannel
+    {
+    public:
+        explicit BoundedChannel(const std::size_t capacity) : capacity(capacity) {}
+
+        bool Write(T data)
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            notFull.wait(lock, [&]() { return closed || buffer.size() < capacity; });
+            if (closed) return false;
+            buffer.push_back(std::move(data));
+            lock.unlock();
+            notEmpty.notify_one();
+            return true;
+        }
+
+        std::optional<T> Read()
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            notEmpty.wait(lock, [&]() { return closed || !buffer.empty(); });
+            if (buffer.empty()) return std::nullopt;
+            auto item = std::move(buffer.front());
+            buffer.pop_front();
+            lock.unlock();
+            notFull.notify_one();
+            return item;
+        }
+
+        void Close()
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            closed = true;
+            lock.unlock();
+            notFull.notify_all();
+            notEmpty.notify_all();
+        }
+
+    private:
+        std::deque<T> buffer{};
+        std::size_t capacity;
+        bool closed = false;
+        std::mutex mtx{};
+        std::condition_variable notFull{};
+        std::condition_variable notEmpty{};
+    };
+
+    // one deque per worker, a worker takes its newest item and steals the oldest item of another worker when it runs dry,
+    // idle workers sleep until an item is queued or every pushed item is done
+    template<typename T>
+    class WorkStealingQueue
+    {
+    public:
+        explicit WorkStealingQueue(const std::size_t workers) : queues(workers) {}
+
+        void Push(const std::size_t worker, T item)
+        {
+            {
+                std::lock_guard<std::mutex> lock(queues[worker].Mtx);
+                queues[worker].Items.push_back(std::move(item));
+            }
+            std::lock_guard<std::mutex> lock(idleMtx);
+            ++pending;
+            ++available;
+            idle.notify_one();
+        }
+
+        // blocks until an item is available, returns nullopt once every pushed item is done
+        std::optional<T> Pop(const std::size_t worker)
+        {
+            {
+                std::unique_lock<std::mutex> lock(idleMtx);
+                idle.wait(lock, [&]() { return pending == 0 || available != 0; });
+                if (pending == 0) return std::nullopt;
+                // claims one of the queued items, the deques hold at least as many items as there are claims
+                --available;
+            }
+            for (;;)
+            {
+                for (std::size_t i = 0; i < queues.size(); ++i)
+                {
+                    auto& queue = queues[(worker + i) % queues.size()];
+                    std::lock_guard<std::mutex> lock(queue.Mtx);
+                    if (queue.Items.empty()) continue;
+                    auto item = i == 0 ? std::move(queue.Items.back()) : std::move(queue.Items.front());
+                    if (i == 0) queue.Items.pop_back();
+                    else queue.Items.pop_front();
+                    return item;
+                }
+            }
+        }
+
+        // called for each popped item after the items it produced were pushed
+        void Done()
+        {
+            std::lock_guard<std::mutex> lock(idleMtx);
+            if (--pending == 0) idle.notify_all();
+        }
+
+    private:
+        struct Queue
+        {
+            std::deque<T> Items{};
+            std::mutex Mtx{};
+        };
+
+        std::vector<Queue> queues;
+        // items pushed and not done yet, and items queued and not claimed yet
+        std::size_t pending = 0;
+        std::size_t available = 0;
+        std::mutex idleMtx{};
+        std::condition_variable idle{};
+    };
+
+    // at most limit holders per key at once, 0 is unlimited
+    template<typename K>
+    class KeyedLimit
+    {
+    public:
+        class Hold
+        {
+        public:
+            Hold() = default;
+            Hold(KeyedLimit* owner, K key) : owner(owner), key(std::move(key)) {}
+            Hold(Hold&& other) noexcept : owner(std::exchange(other.owner, nullptr)), key(std::move(other.key)) {}
+            Hold& operator=(Hold&& other) noexcept
+            {
+                if (this != &other)
+                {
+                    Release();
+                    owner = std::exchange(other.owner, nullptr);
+                    key = std::move(other.key);
+                }
+                return *this;
+            }
+            ~Hold() { Release(); }
+
+        private:
+            void Release()
+            {
+                if (owner) owner->Release(key);
+                owner = nullptr;
+            }
+
+            KeyedLimit* owner = nullptr;
+            K key{};
+        };
+
+        explicit KeyedLimit(const std::size_t limit) : limit(limit) {}
+
+        // callers taking several keys take them in ascending order so they cannot deadlock each other
+        Hold Acquire(const K& key)
+        {
+            if (limit == 0) return {};
+            std::unique_lock<std::mutex> lock(mtx);
+            released.wait(lock, [&]() { return holders[key] < limit; });
+            ++holders[key];
+            return { this, key };
+        }
+
+    private:
+        void Release(const K& key)
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            --holders[key];
+            lock.unlock();
+            released.notify_all();
+        }
+
+        std::size_t limit;
+        std::unordered_map<K, std::size_t> holders{};
+        std::mutex mtx{};
+        std::condition_variable released{};
+    };
+
+    // rate units per second with a burst of one second, 0 is unlimited,
+    // every caller takes its amount at once and sleeps off the debt it leaves
+    class TokenBucket
+    {
+    public:
+        explicit TokenBucket(const std::uint64_t rate) : rate(static_cast<double>(rate)), tokens(static_cast<double>(rate)) {}
+
+        void Acquire(const std::uint64_t amount)
+        {
+            if (rate == 0) return;
+            std::unique_lock<std::mutex> lock(mtx);
+            const auto now = std::chrono::steady_clock::now();
+            tokens = std::min(rate, tokens + rate * std::chrono::duration<double>(now - last).count());
+            last = now;
+            tokens -= static_cast<double>(amount);
+            const auto debt = tokens;
+            lock.unlock();
+            if (debt < 0) std::this_thread::sleep_for(std::chrono::duration<double>(-debt / rate));
+        }
+
+    private:
+        double rate;
+        double tokens;
+        std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now();
+        std::mutex mtx{};
+    };
 }
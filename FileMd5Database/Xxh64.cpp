@@ -0,0 +1,106 @@
+#include "Cryptography.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Cryptography
+{
+	namespace
+	{
+		constexpr std::uint64_t Prime1 = 0x9e3779b185ebca87ull;
+		constexpr std::uint64_t Prime2 = 0xc2b2ae3d27d4eb4full;
+		constexpr std::uint64_t Prime3 = 0x165667b19e3779f9ull;
+		constexpr std::uint64_t Prime4 = 0x85ebca77c2b2ae63ull;
+		constexpr std::uint64_t Prime5 = 0x27d4eb2f165667c5ull;
+
+		constexpr std::uint64_t Rotl(const std::uint64_t x, const int n)
+		{
+			return x << n | x >> (64 - n);
+		}
+
+		std::uint64_t LoadLe64(const std::uint8_t* p)
+		{
+			std::uint64_t x = 0;
+			for (auto i = 0; i < 8; ++i) x |= static_cast<std::uint64_t>(p[i]) << (8 * i);
+			return x;
+		}
+
+		std::uint32_t LoadLe32(const std::uint8_t* p)
+		{
+			return static_cast<std::uint32_t>(p[0]) | static_cast<std::uint32_t>(p[1]) << 8 | static_cast<std::uint32_t>(p[2]) << 16 | static_cast<std::uint32_t>(p[3]) << 24;
+		}
+
+		constexpr std::uint64_t Round(std::uint64_t acc, const std::uint64_t input)
+		{
+			acc += input * Prime2;
+			acc = Rotl(acc, 31);
+			return acc * Prime1;
+		}
+
+		constexpr std::uint64_t MergeRound(std::uint64_t acc, const std::uint64_t val)
+		{
+			acc ^= Round(0, val);
+			return acc * Prime1 + Prime4;
+		}
+	}
+
+	Xxh64::Xxh64(const std::uint64_t seed) :
+		seed(seed),
+		acc{ seed + Prime1 + Prime2, seed + Prime2, seed, seed - Prime1 } {}
+
+	void Xxh64::Append(const std::uint8_t* buf, std::uint64_t len)
+	{
+		length += len;
+		if (bufferLen != 0)
+		{
+			const auto take = std::min<std::uint64_t>(32 - bufferLen, len);
+			memcpy(buffer + bufferLen, buf, take);
+			bufferLen += static_cast<std::uint8_t>(take);
+			buf += take;
+			len -= take;
+			if (bufferLen < 32) return;
+			for (auto i = 0; i < 4; ++i) acc[i] = Round(acc[i], LoadLe64(buffer + i * 8));
+			bufferLen = 0;
+		}
+
+		for (; len >= 32; buf += 32, len -= 32)
+		{
+			for (auto i = 0; i < 4; ++i) acc[i] = Round(acc[i], LoadLe64(buf + i * 8));
+		}
+		if (len != 0) memcpy(buffer, buf, len);
+		bufferLen = static_cast<std::uint8_t>(len);
+	}
+
+	std::uint64_t Xxh64::Digest() const
+	{
+		std::uint64_t h;
+		if (length >= 32)
+		{
+			h = Rotl(acc[0], 1) + Rotl(acc[1], 7) + Rotl(acc[2], 12) + Rotl(acc[3], 18);
+			for (const auto a : acc) h = MergeRound(h, a);
+		}
+		else
+		{
+			h = seed + Prime5;
+		}
+		h += length;
+
+		const auto* p = buffer;
+		auto len = bufferLen;
+		for (; len >= 8; p += 8, len -= 8) h = Rotl(h ^ Round(0, LoadLe64(p)), 27) * Prime1 + Prime4;
+		if (len >= 4)
+		{
+			h = Rotl(h ^ LoadLe32(p) * Prime1, 23) * Prime2 + Prime3;
+			p += 4;
+			len -= 4;
+		}
+		for (; len != 0; ++p, --len) h = Rotl(h ^ *p * Prime5, 11) * Prime1;
+
+		h ^= h >> 33;
+		h *= Prime2;
+		h ^= h >> 29;
+		h *= Prime3;
+		h ^= h >> 32;
+		return h;
+	}
+}
@@ -4,6 +4,7 @@
 #include <unordered_map>
 #include <execution>
 #include <random>
+#include <thread>
 
 
 #include "Macro.h"
@@ -19,7 +20,7 @@
 
 #endif
 
-ArgumentOption(DbOperator, Build, Add, Query, Concat, Export, Alter)
+ArgumentOption(DbOperator, Build, Add, Query, Concat, Export, Alter, Upgrade, Compact)
 
 static Database FileMd5Database{};
 
@@ -100,7 +101,7 @@ int main(int argc, char* argv[])
 	ArgumentsParse::Argument<std::vector<std::string>> skip
 	{
 		"--skip",
-		"skip file(file1;file2;...)",
+		"skip paths, names and globs(/path;name;*.tmp;**/node_modules;...)",
 		decltype(skip)::ValueType{},
 		ArgumentsFunc(skip)
 		{
@@ -118,6 +119,164 @@ int main(int argc, char* argv[])
 			return { files, {} };
 		}
 	};
+	ArgumentsParse::Argument<uint64_t> threads
+	{
+		"--threads",
+		"hash threads[" + Convert::ToString(std::max(std::thread::hardware_concurrency(), 1u)) + "]",
+		std::max(std::thread::hardware_concurrency(), 1u),
+		ArgumentsFunc(threads)
+		{
+			return {Convert::FromString<uint64_t>(std::string(value)), {}};
+		}
+	};
+	ArgumentsParse::Argument<uint64_t> walkThreads
+	{
+		"--walk-threads",
+		"directory listing threads[4]",
+		4,
+		ArgumentsFunc(walkThreads)
+		{
+			return {Convert::FromString<uint64_t>(std::string(value)), {}};
+		}
+	};
+	ArgumentsParse::Argument<bool, 0> forceRehash
+	{
+		"--force-rehash",
+		"rehash files even if size and last modified time are unchanged",
+		false,
+		ArgumentsFunc(forceRehash)
+		{
+			return {true, {}};
+		}
+	};
+	ArgumentsParse::Argument<IoEngine> ioEngine
+	{
+		"--io-engine",
+		"small file reads, Uring falls back to Blocking where unavailable" + IoEngineDesc(ToString(IoEngine::Blocking)),
+		IoEngine::Blocking,
+		ArgumentsFunc(ioEngine)
+		{
+			return {ToIoEngine(std::string(value)), {}};
+		}
+	};
+	ArgumentsParse::Argument<BuildMode> buildMode
+	{
+		"--mode",
+		"Dedup hashes only files whose size and then head and tail collide " + BuildModeDesc(ToString(BuildMode::Full)),
+		BuildMode::Full,
+		ArgumentsFunc(buildMode)
+		{
+			return {ToBuildMode(std::string(value)), {}};
+		}
+	};
+	ArgumentsParse::Argument<ReadOrder> readOrder
+	{
+		"--order",
+		"order of file reads, Inode or Extent against seeks on rotating disks " + ReadOrderDesc(ToString(ReadOrder::Listing)),
+		ReadOrder::Listing,
+		ArgumentsFunc(readOrder)
+		{
+			return {ToReadOrder(std::string(value)), {}};
+		}
+	};
+	ArgumentsParse::Argument<uint64_t> orderBatch
+	{
+		"--order-batch",
+		"files sorted together by --order, there is no order across batches[4096]",
+		4096,
+		ArgumentsFunc(orderBatch)
+		{
+			return {Convert::FromString<uint64_t>(std::string(value)), {}};
+		}
+	};
+	ArgumentsParse::Argument<uint64_t> maxDeviceReads
+	{
+		"--max-device-reads",
+		"files read at once from one device, 0 is unlimited[0]",
+		0,
+		ArgumentsFunc(maxDeviceReads)
+		{
+			return {Convert::FromString<uint64_t>(std::string(value)), {}};
+		}
+	};
+	ArgumentsParse::Argument<uint64_t> maxReadBps
+	{
+		"--max-read-bps",
+		"bytes read per second by all hash threads, K/M/G/T suffixes, 0 is unlimited[0]",
+		0,
+		ArgumentsFunc(maxReadBps)
+		{
+			return {ByteSizeFromString(std::string(value)), {}};
+		}
+	};
+	ArgumentsParse::Argument<IoMode> ioMode
+	{
+		"--io-mode",
+		"page cache use of file reads, Fadvise drops what was read, Direct bypasses it " + IoModeDesc(ToString(IoMode::Buffered)),
+		IoMode::Buffered,
+		ArgumentsFunc(ioMode)
+		{
+			return {ToIoMode(std::string(value)), {}};
+		}
+	};
+	ArgumentsParse::Argument<uint32_t> queueDepth
+	{
+		"--queue-depth",
+		"files in flight per hash thread with the Uring engine[64]",
+		64,
+		ArgumentsFunc(queueDepth)
+		{
+			return {Convert::FromString<uint32_t>(std::string(value)), {}};
+		}
+	};
+	ArgumentsParse::Argument<uint64_t> checkpointFiles
+	{
+		"--checkpoint-files",
+		"append the files merged since the last checkpoint to the database log every n merged files, 0 disables[0]",
+		0,
+		ArgumentsFunc(checkpointFiles)
+		{
+			return {Convert::FromString<uint64_t>(std::string(value)), {}};
+		}
+	};
+	ArgumentsParse::Argument<uint64_t> checkpointSeconds
+	{
+		"--checkpoint-seconds",
+		"append the files merged since the last checkpoint to the database log every n seconds, 0 disables[600]",
+		600,
+		ArgumentsFunc(checkpointSeconds)
+		{
+			return {Convert::FromString<uint64_t>(std::string(value)), {}};
+		}
+	};
+	ArgumentsParse::Argument<bool, 0> resume
+	{
+		"--resume",
+		"skip directories and files recorded by an interrupted build",
+		false,
+		ArgumentsFunc(resume)
+		{
+			return {true, {}};
+		}
+	};
+	ArgumentsParse::Argument<StorageLayout> layout
+	{
+		"--layout",
+		"database layout, kept from the existing database if omitted, Block is a third of Row on disk and loads faster than Row only when the file has to be read from storage slower than about 500 MB/s " + StorageLayoutDesc(),
+		ArgumentsFunc(layout)
+		{
+			return {ToStorageLayout(std::string(value)), {}};
+		}
+	};
+	ArgumentsParse::Argument<HashAlgorithm> hashAlgorithm
+	{
+		"--hash",
+		"hash algorithm of a new database, an existing database keeps its own and its digest length " + HashAlgorithmDesc(ToString(HashAlgorithm::Md5)),
+		ArgumentsFunc(hashAlgorithm)
+		{
+			return {ToHashAlgorithm(std::string(value)), {}};
+		}
+	};
 	ArgumentsParse::Argument<std::filesystem::path> filePath
 	{
 		"--file",
@@ -176,7 +335,7 @@ int main(int argc, char* argv[])
 	ArgumentsParse::Argument keyword
 	{
 		"--keyword",
-		"query keyword"
+		"query keyword (time: YYYY-MM-DD[ HH:MM:SS]|@epoch|-7d)"
 	};
 	ArgumentsParse::Argument paths
 	{
@@ -252,6 +411,22 @@ int main(int argc, char* argv[])
 	args.Add(deviceName);
 	args.Add(rootPath);
 	args.Add(skip);
+	args.Add(threads);
+	args.Add(walkThreads);
+	args.Add(forceRehash);
+	args.Add(ioEngine);
+	args.Add(buildMode);
+	args.Add(readOrder);
+	args.Add(orderBatch);
+	args.Add(maxDeviceReads);
+	args.Add(maxReadBps);
+	args.Add(queueDepth);
+	args.Add(ioMode);
+	args.Add(checkpointFiles);
+	args.Add(checkpointSeconds);
+	args.Add(resume);
+	args.Add(layout);
+	args.Add(hashAlgorithm);
 	args.Add(filePath);
 	args.Add(matchMethod);
 	args.Add(queryData);
@@ -342,20 +517,15 @@ int main(int argc, char* argv[])
 								std::cout << "DatabasePath";
 								return false;
 							}
-							std::vector<Model> data{};
-							DeserializationAsModel(data, args);
-							puts(Convert::ToString(data.size()).c_str());
-							std::vector<ModelRef> fmd(data.size());
-							std::transform(std::execution::par_unseq, data.begin(), data.end(), fmd.begin(), [](const Model& model) { return ModelRef(std::string_view(model.Path.str, model.Path.size), std::string_view(model.Md5.str, model.Md5.size), model.Size, std::string_view(model.Time.str, model.Time.size)); });
-							std::vector<char*> address(data.size());
-							std::transform(std::execution::par_unseq, data.begin(), data.end(), address.begin(), [](const Model& model) { return model.Path.str; });
-							data.clear();
-							data.shrink_to_fit();
+							const File::MemoryMap map(args);
+							Database log{};
+							ReplayLog(log, args);
+							std::vector<ModelRef> fmd{};
+							PathTree tree{};
+							DeserializationAsModel(fmd, tree, map);
+							MergeLog(fmd, log);
+							puts(Convert::ToString(fmd.size()).c_str());
 							Interactive(fmd);
-							std::for_each(std::execution::par_unseq, address.begin(), address.end(), [](const char* addr) { delete[] addr; });
-#ifndef MacroWindows
-							malloc_trim(0);
-#endif
 							return false;
 						} },
 						{ "sort",[&](const std::string& args = {}, const bool help = false)
@@ -420,7 +590,7 @@ int main(int argc, char* argv[])
 							{
 								return false;
 							}
-							puts(Convert::ToString(std::max_element(std::execution::par_unseq, fmd.begin(), fmd.end(), [](const ModelRef& a, const ModelRef& b) { return std::less<>()(a.Path.length(), b.Path.length()); })->Path.length()).c_str());
+							puts(Convert::ToString(std::transform_reduce(std::execution::par_unseq, fmd.begin(), fmd.end(), uint64_t{ 0 }, [](const uint64_t a, const uint64_t b) { return std::max(a, b); }, [](const ModelRef& model) { return static_cast<uint64_t>(model.Path().length()); })).c_str());
 							return false;
 						} },
 						{ "sum",[&](const std::string& args = {}, const bool help = false)
@@ -508,14 +678,14 @@ int main(int argc, char* argv[])
 							{
 								return false;
 							}
-							std::vector<std::string_view> devices(fmd.size());
-							std::transform(std::execution::par_unseq, fmd.begin(), fmd.end(), devices.begin(), [](const ModelRef& model) { return model.Path.substr(0, model.Path.find(':')); });
+							std::vector<std::string> devices(fmd.size());
+							std::transform(std::execution::par_unseq, fmd.begin(), fmd.end(), devices.begin(), [](const ModelRef& model) { auto path = model.Path(); return path.substr(0, path.find(':')); });
 							std::sort(std::execution::par_unseq, devices.begin(), devices.end());
 							const auto last = std::unique(std::execution::par_unseq, devices.begin(), devices.end());
 							devices.erase(last, devices.end());
 							devices.shrink_to_fit();
 							std::sort(devices.begin(), devices.end());
-							std::copy(devices.begin(), devices.end(), std::ostream_iterator<std::string_view>(std::cout, "\n"));
+							std::copy(devices.begin(), devices.end(), std::ostream_iterator<std::string>(std::cout, "\n"));
 							return false;
 						} },
 						{ "unique",[&](const std::string& args = {}, const bool help = false)
@@ -545,39 +715,24 @@ int main(int argc, char* argv[])
 								std::vector<ModelRef> resTmp{};
 								[&]()
 								{
-									std::unordered_map<std::string_view, uint64_t> md5Freqs{};
+									std::vector<Md5Digest> duplicates{};
 									[&]()
 									{
-										std::vector<std::string_view> md5s(fmd.size());
-										std::transform(std::execution::par_unseq, fmd.begin(), fmd.end(), md5s.begin(), [](const ModelRef& model) { return model.Md5; });
+										std::vector<Md5Digest> md5s(fmd.size());
+										std::transform(std::execution::par_unseq, fmd.begin(), fmd.end(), md5s.begin(), [](const ModelRef& model) { return model.Flags & RecordFlag::Partial ? Md5Digest{} : model.Md5; });
 										std::sort(std::execution::par_unseq, md5s.begin(), md5s.end());
-										const auto last = std::unique(std::execution::par_unseq, md5s.begin(), md5s.end());
-										md5s.erase(last, md5s.end());
-										md5s.shrink_to_fit();
-										for (auto md5 : md5s)
+										for (std::size_t i = 1; i < md5s.size(); ++i)
 										{
-											md5Freqs.emplace(md5, 0);
+											if (md5s[i] == md5s[i - 1] && !IsNilMd5(md5s[i]) && (duplicates.empty() || duplicates.back() != md5s[i]))
+											{
+												duplicates.push_back(md5s[i]);
+											}
 										}
 									}();
-									for (const auto& model : fmd)
-									{
-										md5Freqs[model.Md5] = md5Freqs.at(model.Md5) + 1;
-									}
-									for (auto it = md5Freqs.begin(); it != md5Freqs.end();)
-									{
-										if (it->second == 1 || it->first.size() == 0)
-										{
-											it = md5Freqs.erase(it);
-										}
-										else
-										{
-											++it;
-										}
-									}
 									resTmp.resize(fmd.size());
-									std::transform(std::execution::par_unseq, fmd.begin(), fmd.end(), resTmp.begin(), [&](const ModelRef& model) { return md5Freqs.find(model.Md5) == md5Freqs.end() ? ModelRef{} : model; });
+									std::transform(std::execution::par_unseq, fmd.begin(), fmd.end(), resTmp.begin(), [&](const ModelRef& model) { return !(model.Flags & RecordFlag::Partial) && std::binary_search(duplicates.begin(), duplicates.end(), model.Md5) ? model : ModelRef{}; });
 								}();
-								const auto isNil = [](const ModelRef& model) { return model.Path.size() != 0; };
+								const auto isNil = [](const ModelRef& model) { return model.Name.size() != 0; };
 								res.resize(std::count_if(std::execution::par_unseq, resTmp.begin(), resTmp.end(), isNil));
 								std::copy_if(std::execution::par_unseq, resTmp.begin(), resTmp.end(), res.begin(), isNil);
 							}();
@@ -613,34 +768,89 @@ int main(int argc, char* argv[])
 
 		FileMd5DatabaseInit(ArgumentsValue(logLevel), ArgumentsValue(logPath), ArgumentsValue(consoleLog));
 		logStarted = true;
+
+		const auto storageLayout = args.Get<StorageLayout>(layout).value_or(DatabaseLayout(databaseFilePath));
+		const auto algorithm = args.Get<HashAlgorithm>(hashAlgorithm).value_or(DatabaseAlgorithm(databaseFilePath));
+		if (exists(databaseFilePath) && algorithm != DatabaseAlgorithm(databaseFilePath))
+		{
+			throw std::runtime_error("database hashes with " + ToString(DatabaseAlgorithm(databaseFilePath)) + ", " + ToString(algorithm) + " needs a new database");
+		}
+		// databases before format version 10 keep their 16 byte digests, a new database stores whole digests
+		Md5Digest::Len = DatabaseDigestLen(databaseFilePath, algorithm);
 		
+		// Upgrade brings the database to the current format, Compact folds the log into it, both by rewriting it
+		const auto rewrite = [databaseFilePath, storageLayout, algorithm]()
+		{
+			Deserialization(FileMd5Database, databaseFilePath);
+			Serialization(FileMd5Database, databaseFilePath, storageLayout, algorithm);
+		};
+
 		std::unordered_map<DbOperator, std::function<void()>>
 		{
-			{ DbOperator::Build, [databaseFilePath, args, deviceName, rootPath, skip]()
+			{ DbOperator::Build, [databaseFilePath, storageLayout, algorithm, args, deviceName, rootPath, skip, threads, walkThreads, forceRehash, ioEngine, buildMode, readOrder, orderBatch, maxDeviceReads, maxReadBps, queueDepth, ioMode, checkpointFiles, checkpointSeconds, resume]()
 			{
 				if (exists(databaseFilePath)) Deserialization(FileMd5Database, databaseFilePath);
-				FileMd5DatabaseBuilder(ArgumentsValue(deviceName), ArgumentsValue(rootPath), FileMd5Database, ArgumentsValue(skip));
-				Serialization(FileMd5Database, databaseFilePath);
+				BuilderOptions options{};
+				options.Threads = ArgumentsValue(threads);
+				options.WalkThreads = ArgumentsValue(walkThreads);
+				options.ForceRehash = ArgumentsValue(forceRehash);
+				options.Algorithm = algorithm;
+				options.Engine = ArgumentsValue(ioEngine);
+				options.Mode = ArgumentsValue(buildMode);
+				options.Order = ArgumentsValue(readOrder);
+				options.OrderBatch = ArgumentsValue(orderBatch);
+				options.MaxDeviceReads = ArgumentsValue(maxDeviceReads);
+				options.MaxReadBps = ArgumentsValue(maxReadBps);
+				options.QueueDepth = ArgumentsValue(queueDepth);
+				options.ReadMode = ArgumentsValue(ioMode);
+				options.CheckpointFiles = ArgumentsValue(checkpointFiles);
+				options.CheckpointSeconds = ArgumentsValue(checkpointSeconds);
+				options.Checkpoint = [&](const Database& records, const BuildProgress& progress)
+				{
+					// the log is replayed by the next load, the database itself is rewritten once the build finishes
+					if (!exists(databaseFilePath)) Serialization(Database{}, databaseFilePath, storageLayout, algorithm);
+					AppendLog(records, databaseFilePath);
+					SerializationProgress(progress, databaseFilePath);
+				};
+				options.Resume = ArgumentsValue(resume);
+				if (options.Resume) options.Resumed = DeserializationProgress(databaseFilePath);
+				FileMd5DatabaseBuilder(ArgumentsValue(deviceName), ArgumentsValue(rootPath), FileMd5Database, ArgumentsValue(skip), options);
+				Serialization(FileMd5Database, databaseFilePath, storageLayout, algorithm);
+				std::filesystem::remove(ProgressPath(databaseFilePath));
 			} },
-			{ DbOperator::Add, [databaseFilePath, args, deviceName, filePath]()
+			{ DbOperator::Add, [databaseFilePath, storageLayout, algorithm, args, deviceName, filePath]()
 			{
-				if (exists(databaseFilePath)) Deserialization(FileMd5Database, databaseFilePath);
-				FileMd5DatabaseAdd(deviceName, ArgumentsValue(filePath), FileMd5Database);
-				Serialization(FileMd5Database, databaseFilePath);
+				if (!exists(databaseFilePath)) Serialization(FileMd5Database, databaseFilePath, storageLayout, algorithm);
+				FileMd5DatabaseAdd(ArgumentsValue(deviceName), ArgumentsValue(filePath), FileMd5Database, algorithm);
+				AppendLog(FileMd5Database, databaseFilePath);
 			} },
 			{ DbOperator::Query, [databaseFilePath, args, matchMethod, queryData, sortBy, keyword, limit, desc]()
 			{
-				std::vector<Model> fmd{};
-				DeserializationAsModel(fmd, databaseFilePath);
-				FileMd5DatabaseQuery(fmd,
-					ArgumentsValue(matchMethod),
-					ArgumentsValue(queryData),
-					ArgumentsValue(sortBy),
-					std::filesystem::path(ArgumentsValue(keyword)).u8string(),
-					ArgumentsValue(limit),
-					ArgumentsValue(desc));
+				const File::MemoryMap map(databaseFilePath);
+				Database log{};
+				ReplayLog(log, databaseFilePath);
+				const auto query = [&](const auto& fmd)
+				{
+					FileMd5DatabaseQuery(fmd,
+						ArgumentsValue(matchMethod),
+						ArgumentsValue(queryData),
+						ArgumentsValue(sortBy),
+						std::filesystem::path(ArgumentsValue(keyword)).u8string(),
+						ArgumentsValue(limit),
+						ArgumentsValue(desc));
+				};
+				PathTree tree{};
+				if (ColumnStore columns{}; log.empty() && DeserializationAsColumns(columns, tree, map))
+				{
+					query(columns);
+					return;
+				}
+				std::vector<ModelRef> fmd{};
+				DeserializationAsModel(fmd, tree, map);
+				MergeLog(fmd, log);
+				query(fmd);
 			} },
-			{ DbOperator::Concat, [databaseFilePath, args, paths]()
+			{ DbOperator::Concat, [databaseFilePath, storageLayout, algorithm, args, paths]()
 			{
 				const auto p = ArgumentsValue(paths) + ";";
 				const std::regex re(R"([^;]+?;)");
@@ -650,12 +860,17 @@ int main(int argc, char* argv[])
 				{
 					const auto match = i->str();
 					const auto dbp = match.substr(0, match.length() - 1);
+					if (DatabaseAlgorithm(dbp) != algorithm) throw std::runtime_error(dbp + " hashes with " + ToString(DatabaseAlgorithm(dbp)) + ", not " + ToString(algorithm));
+					if (DatabaseDigestLen(dbp, algorithm) != Md5Digest::Len)
+					{
+						throw std::runtime_error(dbp + " stores " + std::to_string(DatabaseDigestLen(dbp, algorithm)) + " byte digests, not " + std::to_string(Md5Digest::Len));
+					}
 					std::cout << "Deserialization " << dbp << " ... ";
 					Deserialization(FileMd5Database, dbp);
 					std::cout << "[done]\n";
 				}
 				std::cout << "Serialization " << databaseFilePath << " ... ";
-				Serialization(FileMd5Database, databaseFilePath);
+				Serialization(FileMd5Database, databaseFilePath, storageLayout, algorithm);
 				std::cout << "[done]\n";
 			} },
 			{ DbOperator::Export, [databaseFilePath, args, exportFormat, exportPath]()
@@ -663,7 +878,7 @@ int main(int argc, char* argv[])
 				Deserialization(FileMd5Database, databaseFilePath);
 				Export(FileMd5Database, ArgumentsValue(exportPath), ArgumentsValue(exportFormat));
 			} },
-			{ DbOperator::Alter, [databaseFilePath, args, alterType, value]()
+			{ DbOperator::Alter, [databaseFilePath, storageLayout, algorithm, args, alterType, value]()
 			{
 				Database fmd;
 				Deserialization(fmd, databaseFilePath);
@@ -683,14 +898,16 @@ int main(int argc, char* argv[])
 					{
 						for (const auto& [k, v] : fmd)
 						{
-							auto newPath = k;
+							auto newPath = std::string(k);
 							newPath[k.find(':') + 1] = newValue[0];
 							FileMd5Database[newPath] = v;
 						}
 					} }
 				}.at(ArgumentsValue(alterType))();
-				Serialization(FileMd5Database, databaseFilePath);
+				Serialization(FileMd5Database, databaseFilePath, storageLayout, algorithm);
 			} },
+			{ DbOperator::Upgrade, rewrite },
+			{ DbOperator::Compact, rewrite },
 		}.at(ArgumentsValue(dbOp))();
 	}
 #ifdef Ex
@@ -698,17 +915,21 @@ int main(int argc, char* argv[])
 	{
 		std::cout << ex.what() << "\n" << args.GetDesc() << R"(
 Build:
-    --device --root -p [--skip]
+    --device --root -p [--skip] [--threads] [--walk-threads] [--force-rehash] [--mode] [--order] [--order-batch] [--max-device-reads] [--max-read-bps] [--io-engine] [--queue-depth] [--io-mode] [--checkpoint-files] [--checkpoint-seconds] [--resume] [--layout] [--hash]
 Add:
-    --device --file -p
+    --device --file -p [--layout]
 Query:
     --keyword -p [--data] [--desc] [--limit] [--method] [--sort]
 Concat:
-    --paths -p
+    --paths -p [--layout] [--hash]
 Export:
     --exoprtFormat --exportPath -p
 Alter:
-    --alterType --value -p
+    --alterType --value -p [--layout]
+Upgrade:
+    -p [--layout]
+Compact:
+    -p [--layout]
 
 Interactive:
     --interactive